@@ -1,7 +1,11 @@
 #include "json.h"
+#include "json_simd.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <tuple>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -11,7 +15,7 @@ namespace json {
   // This code is "borrowed" from here: http://stackoverflow.com/a/33799784
   // This stability not really required in this assignment, however, it's `proven to work` as
   // in `I trust everything I can find on the Web`
-  std::string escape(const std::string& str) {
+  std::string escape(std::string_view str) {
     std::ostringstream o;
     o << '"';
     for (const auto& c : str) {
@@ -48,36 +52,488 @@ namespace json {
     return os;
   }
 
+  namespace detail {
+    // Multiply-xorshift hash over 8 byte words, keys are short, so it is only a few multiplications for most of them.
+    uint32_t hash_key(std::string_view key) {
+      constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+      uint64_t hash = key.size() * multiplier;
+      const char* data = key.data();
+      size_t left = key.size();
+      for (; left >= 8; data += 8, left -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+      }
+      if (left != 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, left);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+      }
+      return uint32_t(hash ^ (hash >> 32));
+    }
+
+    const key_block* key_block::make(std::string_view text, uint32_t hash, std::pmr::memory_resource* resource) {
+      if (text.size() > UINT32_MAX) {
+        throw json_error("Object key of [size=" + utils::to_string(text.size()) + "] is too long.");
+      }
+      auto* key = new (resource->allocate(sizeof(key_block) + text.size(), alignof(key_block))) key_block{hash, uint32_t(text.size())};
+      std::memcpy(const_cast<char*>(key->data()), text.data(), text.size());
+      return key;
+    }
+
+    void key_block::destroy(const key_block* key, std::pmr::memory_resource* resource) noexcept {
+      resource->deallocate(const_cast<key_block*>(key), sizeof(key_block) + key->size, alignof(key_block));
+    }
+
+    const key_block* key_block::empty() noexcept {
+      static const key_block block{hash_key(std::string_view()), 0};
+      return &block;
+    }
+
+    object_key::object_key(std::string_view text, uint32_t hash, std::pmr::memory_resource* resource) {
+      if (text.size() <= inline_size) {
+        std::memcpy(bytes, text.data(), text.size());
+        bytes[inline_size] = char(text.size());
+      } else {
+        const key_block* block = key_block::make(text, hash, resource);
+        std::memcpy(bytes, &block, sizeof(block));
+        bytes[inline_size] = char(owned);
+      }
+    }
+
+    object_key::object_key(const key_block* block) {
+      std::memcpy(bytes, &block, sizeof(block));
+      bytes[inline_size] = char(shared);
+    }
+
+    const key_block* object_key::block() const {
+      if (uint8_t(bytes[inline_size]) <= inline_size) {
+        return nullptr;
+      }
+      const key_block* block;
+      std::memcpy(&block, bytes, sizeof(block));
+      return block;
+    }
+
+    std::string_view object_key::text() const {
+      const uint8_t size = uint8_t(bytes[inline_size]);
+      return size <= inline_size ? std::string_view(bytes, size) : block()->text();
+    }
+
+    object_key object_key::copy(std::pmr::memory_resource* resource) const {
+      if (uint8_t(bytes[inline_size]) != owned) {
+        return *this;
+      }
+      const key_block* key = block();
+      return object_key(key->text(), key->hash, resource);
+    }
+
+    void object_key::release(std::pmr::memory_resource* resource) noexcept {
+      if (uint8_t(bytes[inline_size]) == owned) {
+        key_block::destroy(block(), resource);
+      }
+    }
+
+    static_assert(alignof(object_map::entry) <= alignof(void*), "Entries should be aligned right after the header.");
+
+    size_t object_map::find(std::string_view key) const {
+      if (empty()) {
+        return npos;
+      }
+      const uint32_t hash = hash_key(key);
+      const entry* items = entries();
+      const uint32_t* hash_of = hashes();
+      if (storage->slots == 0) {
+        const uint32_t* end = hash_of + storage->size;
+        for (const uint32_t* it = simd::find_uint32(hash_of, end, hash); it != end; it = simd::find_uint32(it + 1, end, hash)) {
+          if (items[it - hash_of].first.text() == key) {
+            return it - hash_of;
+          }
+        }
+        return npos;
+      }
+      const uint32_t* slots = index();
+      const size_t mask = storage->slots - 1;
+      for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+        const size_t position = slots[slot] - 1;
+        if (hash_of[position] == hash && items[position].first.text() == key) {
+          return position;
+        }
+      }
+      return npos;
+    }
+
+    size_t object_map::find(const key_block* key) const {
+      if (empty()) {
+        return npos;
+      }
+      const entry* items = entries();
+      const uint32_t* hash_of = hashes();
+      // Same block is the common case, text is only compared for keys that were not interned.
+      auto same = [key](const object_key& other) { return other.block() == key || other.text() == key->text(); };
+      if (storage->slots == 0) {
+        const uint32_t* end = hash_of + storage->size;
+        for (const uint32_t* it = simd::find_uint32(hash_of, end, key->hash); it != end; it = simd::find_uint32(it + 1, end, key->hash)) {
+          if (same(items[it - hash_of].first)) {
+            return it - hash_of;
+          }
+        }
+        return npos;
+      }
+      const uint32_t* slots = index();
+      const size_t mask = storage->slots - 1;
+      for (size_t slot = key->hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+        const size_t position = slots[slot] - 1;
+        if (hash_of[position] == key->hash && same(items[position].first)) {
+          return position;
+        }
+      }
+      return npos;
+    }
+
+    size_t object_map::append(std::string_view key, value&& val, std::pmr::memory_resource* resource) {
+      const uint32_t hash = hash_key(key);
+      object_key copy(key, hash, resource);
+      try {
+        return push(copy, hash, std::move(val), resource);
+      } catch (...) {
+        copy.release(resource);
+        throw;
+      }
+    }
+
+    size_t object_map::append(const key_block* key, value&& val, std::pmr::memory_resource* resource) {
+      return push(object_key(key), key->hash, std::move(val), resource);
+    }
+
+    size_t object_map::push(object_key key, uint32_t hash, value&& val, std::pmr::memory_resource* resource) {
+      assert(!shared());
+      const size_t count = size();
+      if (!storage || count == storage->capacity) {
+        const size_t capacity = std::max<size_t>(count * 2, 4);
+        relocate(capacity, slots_for(capacity), resource);
+      }
+      new (entries() + count) entry(key, std::move(val));
+      hashes()[count] = hash;
+      storage->size = uint32_t(count + 1);
+      if (storage->slots != 0) {
+        uint32_t* slots = index();
+        const size_t mask = storage->slots - 1;
+        size_t slot = hash & mask;
+        while (slots[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+        slots[slot] = uint32_t(count + 1);
+      }
+      return count;
+    }
+
+    void object_map::erase(size_t position, std::pmr::memory_resource* resource) {
+      assert(!shared());
+      entry* items = entries();
+      uint32_t* hash_of = hashes();
+      const size_t count = size();
+      items[position].first.release(resource);
+      items[position].~entry();
+      for (size_t i = position + 1; i < count; ++i) {
+        new (items + i - 1) entry(std::move(items[i]));
+        items[i].~entry();
+        hash_of[i - 1] = hash_of[i];
+      }
+      storage->size = uint32_t(count - 1);
+      if (storage->slots != 0) {
+        fill_index();
+      }
+    }
+
+    void object_map::truncate(size_t size, std::pmr::memory_resource* resource) {
+      if (size >= this->size()) {
+        return;
+      }
+      assert(!shared());
+      entry* items = entries();
+      for (size_t i = size; i < storage->size; ++i) {
+        items[i].first.release(resource);
+        items[i].~entry();
+      }
+      storage->size = uint32_t(size);
+      if (storage->slots != 0) {
+        fill_index();
+      }
+    }
+
+    void object_map::swap(size_t first, size_t second) {
+      assert(!shared());
+      using std::swap;
+      if (storage->slots != 0) {
+        // Entries keep their hashes, so only the two slots referring to them change.
+        uint32_t* first_slot = slot_of(first);
+        uint32_t* second_slot = slot_of(second);
+        *first_slot = uint32_t(second + 1);
+        *second_slot = uint32_t(first + 1);
+      }
+      entry& lhs = entries()[first];
+      entry& rhs = entries()[second];
+      const object_key key = lhs.first;
+      lhs.first = rhs.first;
+      rhs.first = key;
+      swap(lhs.second, rhs.second);
+      swap(hashes()[first], hashes()[second]);
+    }
+
+    uint32_t* object_map::slot_of(size_t position) const {
+      uint32_t* slots = index();
+      const size_t mask = storage->slots - 1;
+      size_t slot = hashes()[position] & mask;
+      while (slots[slot] != position + 1) {
+        slot = (slot + 1) & mask;
+      }
+      return slots + slot;
+    }
+
+    void object_map::reserve(size_t count, std::pmr::memory_resource* resource) {
+      if (count > (storage ? storage->capacity : 0)) {
+        relocate(count, slots_for(count), resource);
+      }
+    }
+
+    void object_map::release(std::pmr::memory_resource* resource) noexcept {
+      if (!storage) {
+        return;
+      }
+      if (storage->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        storage = nullptr;
+        return;
+      }
+      entry* items = entries();
+      for (size_t i = 0; i < storage->size; ++i) {
+        items[i].first.release(resource);
+        items[i].~entry();
+      }
+      resource->deallocate(storage, sizeof(header) + storage->capacity * sizeof(entry) + (storage->slots + storage->capacity) * sizeof(uint32_t), alignof(header));
+      storage = nullptr;
+    }
+
+    object_map object_map::share() const noexcept {
+      if (storage) {
+        storage->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+      object_map copy;
+      copy.storage = storage;
+      return copy;
+    }
+
+    object_map object_map::clone(std::pmr::memory_resource* resource) const {
+      object_map copy;
+      if (!storage) {
+        return copy;
+      }
+      copy.storage = allocate(storage->capacity, storage->slots, resource);
+      const entry* items = entries();
+      try {
+        for (; copy.storage->size < storage->size; ++copy.storage->size) {
+          const entry& item = items[copy.storage->size];
+          object_key key = item.first.copy(resource);
+          try {
+            new (copy.entries() + copy.storage->size) entry(key, value(item.second, resource));
+          } catch (...) {
+            key.release(resource);
+            throw;
+          }
+        }
+      } catch (...) {
+        copy.release(resource);
+        throw;
+      }
+      // Index slots are followed by the hashes.
+      std::copy(index(), hashes() + storage->size, copy.index());
+      return copy;
+    }
+
+    object_map::header* object_map::allocate(size_t capacity, size_t slots, std::pmr::memory_resource* resource) {
+      if (capacity > UINT32_MAX) {
+        throw json_error("Object of [size=" + utils::to_string(capacity) + "] is too large.");
+      }
+      return new (resource->allocate(sizeof(header) + capacity * sizeof(entry) + (slots + capacity) * sizeof(uint32_t), alignof(header)))
+        header{0, uint32_t(capacity), uint32_t(slots), 1, 0, false};
+    }
+
+    void object_map::relocate(size_t capacity, size_t slots, std::pmr::memory_resource* resource) {
+      assert(!shared());
+      object_map moved;
+      moved.storage = allocate(capacity, slots, resource);
+      if (storage) {
+        entry* items = entries();
+        for (size_t i = 0; i < storage->size; ++i) {
+          new (moved.entries() + i) entry(std::move(items[i]));
+          items[i].~entry();
+        }
+        std::copy(hashes(), hashes() + storage->size, moved.hashes());
+        moved.storage->size = storage->size; // References to the old entries are gone, so the new storage isn't leaked.
+        storage->size = 0; // Keys have moved.
+        release(resource);
+      }
+      storage = moved.storage;
+      if (slots != 0) {
+        fill_index();
+      }
+    }
+
+    void object_map::fill_index() {
+      uint32_t* slots = index();
+      const uint32_t* hash_of = hashes();
+      const size_t mask = storage->slots - 1;
+      std::fill(slots, slots + storage->slots, 0);
+      for (size_t position = 0; position < storage->size; ++position) {
+        size_t slot = hash_of[position] & mask;
+        while (slots[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+        slots[slot] = uint32_t(position + 1);
+      }
+    }
+
+    // Index has between 2 and 4 slots per entry when object is full.
+    size_t object_map::slots_for(size_t size) {
+      if (size <= indexed_size) {
+        return 0;
+      }
+      size_t slots = 128;
+      while (slots < size * 2) {
+        slots *= 2;
+      }
+      return slots;
+    }
+  }
+
+  namespace detail {
+    string_rep* string_rep::make(std::string_view text, std::pmr::memory_resource* resource, bool shared) {
+      if (text.size() > UINT32_MAX) {
+        throw json_error("String of [size=" + utils::to_string(text.size()) + "] is too long.");
+      }
+      const uint32_t size = uint32_t(text.size());
+      auto* rep = new (resource->allocate(sizeof(string_rep) + size, alignof(string_rep))) string_rep{size, shared ? 0 : size, 1};
+      std::memcpy(rep->data(), text.data(), size);
+      return rep;
+    }
+
+    string_rep* string_rep::share(string_rep* rep) noexcept {
+      if (rep && rep->capacity != 0) {
+        rep->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+      return rep;
+    }
+
+    void string_rep::release(string_rep* rep, std::pmr::memory_resource* resource) noexcept {
+      if (rep->capacity != 0 && rep->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        resource->deallocate(rep, sizeof(string_rep) + rep->capacity, alignof(string_rep));
+      }
+    }
+  }
+
+  key::key(std::string_view text)
+    : block(detail::key_block::make(text, detail::hash_key(text), std::pmr::new_delete_resource())), arena(nullptr) {}
+
+  key::key(const key& other)
+    : block(other.arena ? other.block : detail::key_block::make(other.text(), other.hash(), std::pmr::new_delete_resource())), arena(other.arena) {}
+
+  key::key(key&& other) noexcept : block(other.block), arena(other.arena) {
+    other.block = detail::key_block::empty();
+    other.arena = nullptr;
+  }
+
+  key& key::operator=(const key& other) {
+    if (this != &other) {
+      key copy(other);
+      std::swap(block, copy.block);
+      std::swap(arena, copy.arena);
+    }
+    return *this;
+  }
+
+  key& key::operator=(key&& other) noexcept {
+    std::swap(block, other.block);
+    std::swap(arena, other.arena);
+    return *this;
+  }
+
+  key::~key() {
+    if (!arena && block != detail::key_block::empty()) {
+      detail::key_block::destroy(block, std::pmr::new_delete_resource());
+    }
+  }
+
+  // Containers are allocated from the resource of their value.
+  template<typename T>
+  T* create(std::pmr::memory_resource* resource) {
+    void* memory = resource->allocate(sizeof(T), alignof(T));
+    try {
+      return new (memory) T(resource);
+    } catch (...) {
+      resource->deallocate(memory, sizeof(T), alignof(T));
+      throw;
+    }
+  }
+
+  template<typename T>
+  void destroy(T* container, std::pmr::memory_resource* resource) noexcept {
+    container->~T();
+    resource->deallocate(container, sizeof(T), alignof(T));
+  }
+
+  // Copy of given array for a single owner, elements share their contents with the ones of given array.
+  static detail::array_rep* clone_array(const detail::array_rep& array, std::pmr::memory_resource* resource) {
+    detail::array_rep* copy = create<detail::array_rep>(resource);
+    try {
+      copy->reserve(array.size());
+      for (auto& el : array) {
+        copy->push_back(value(el, resource));
+      }
+    } catch (...) {
+      destroy(copy, resource);
+      throw;
+    }
+    return copy;
+  }
+
+  // Drops a reference to shared array, which is destroyed once the last one is gone.
+  static void release_array(detail::array_rep* array, std::pmr::memory_resource* resource) noexcept {
+    if (array->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      destroy(array, resource);
+    }
+  }
+
   // Releases resources held by this instance.
   // Does not throw.
   value::~value() {
     release();
   }
 
-  // This function is noexcept because ~string() doesn't throw by standard
-  // and ~vector() and ~unordered_map() are _quite likely_ do not throw if destructors
-  // for contained items do not throw. Since items here are string and value, whose
-  // destructors do not throw, it's arguably safe to assume this method doesn't throw.
+  // This function is noexcept because ~vector() and ~object_map() are _quite likely_ do not throw if destructors
+  // for contained items do not throw. Since items here are keys and values, whose destructors do not throw, it's
+  // arguably safe to assume this method doesn't throw.
   void value::release() noexcept {
-    using std::string;
-    using std::unordered_map;
-    using std::vector;
-
-    switch (type) {
+    switch (type()) {
     case value_type::null: 
     case value_type::number: 
     case value_type::boolean: 
       break;
     case value_type::string:
-      this->string.~string();
+      if (string) {
+        detail::string_rep::release(string, resource());
+      }
       break;
     case value_type::object:
-      this->object.~unordered_map();
+      object.release(resource());
       break;
     case value_type::array:
-      this->array.~vector();
+      release_array(array, resource());
       break;
     }
+    retype(value_type::null);
+    number = 0;
   }
 
   // Assertion-like function that checks if given value is of appropriate type for operation.
@@ -88,41 +544,163 @@ namespace json {
     }
   }
 
+  void value::init(value_type t) {
+    switch(t) {
+    case value_type::null:    number = 0;      break;
+    case value_type::boolean: boolean = false; break;
+    case value_type::number:  number = 0;      break; 
+    case value_type::string:  string = nullptr; break;
+    case value_type::object:  new (&object) detail::object_map(); break;
+    case value_type::array:   array = create<detail::array_rep>(resource()); break;
+    default:
+      throw json_error("Unknown [value_type=" + utils::to_string(t) + "] encountered during construction.");
+    }
+    retype(t);
+  }
+
   // Copies contents from other value.
   void value::from(const value& other) {
-    assert(type == other.type); // This method is assumed to be invoked after type is properly set.
-                                // Although not super-good decision, it allows setting type in initalizer expression
-                                // of copy-constructor.
-    switch (other.type) {
-    case value_type::null:    break; // Leave union unitialized.
+    assert(type() == other.type()); // This method is assumed to be invoked after init(other.type()).
+    switch (other.type()) {
+    case value_type::null:    break;
     case value_type::number:  this->number  = other.number;  break; 
     case value_type::boolean: this->boolean = other.boolean; break; 
-    case value_type::string:  this->string  = other.string;  break;
+    case value_type::string:
+      if (other.string && other.string->size != 0) {
+        this->string = detail::string_rep::make(other.string->text(), resource());
+      }
+      break;
     case value_type::object:
+      this->object.reserve(other.object.size(), resource());
       for (auto& el : other.object) {
-        this->object.insert(std::make_pair(el.first, std::make_unique<value>(*el.second)));
+        this->object.append(el.first.text(), value(el.second, resource()), resource());
       }
       break;
     case value_type::array:
-      for (auto& el : other.array) {
-        this->array.push_back(std::make_unique<value>(*el));
+      this->array->reserve(other.array->size());
+      for (auto& el : *other.array) {
+        this->array->push_back(value(el, resource()));
       }
       break;
     }
   }
 
-  value::value(const value& other) : value(other.type) {
-    from(other);
-  }
-
-  value::value(value&& other) : value(other.type) {
-    switch (other.type) {
-    case value_type::null:    this->number  = 0;             break;
+  void value::take(value&& other) noexcept {
+    assert(type() == value_type::null); // Nothing is held.
+    retype(other.type());
+    number = 0;
+    switch (other.type()) {
+    case value_type::null:    break;
     case value_type::number:  this->number  = other.number;  break; 
     case value_type::boolean: this->boolean = other.boolean; break; 
-    case value_type::string:  new (&string) std::string(std::move(other.string)); break;
-    case value_type::object:  new (&object) std::unordered_map<std::string, std::unique_ptr<value>>(std::move(other.object)); break;
-    case value_type::array:   new (&array) std::vector<std::unique_ptr<value>>(std::move(other.array));  break;
+    case value_type::string:  this->string  = other.string;  break;
+    case value_type::object:  this->object  = other.object;  break;
+    case value_type::array:   this->array   = other.array;   break;
+    }
+    other.retype(value_type::null);
+    other.number = 0;
+  }
+
+  void value::share(const value& other) {
+    assert(type() == value_type::null); // Nothing is held.
+    number = 0;
+    switch (other.type()) {
+    case value_type::null:    break;
+    case value_type::number:  this->number  = other.number;  break;
+    case value_type::boolean: this->boolean = other.boolean; break;
+    case value_type::string:  this->string  = detail::string_rep::share(other.string); break;
+    case value_type::object:  this->object  = other.object.leaked() ? other.object.clone(resource()) : other.object.share(); break;
+    case value_type::array:
+      if (other.array->leaked) {
+        this->array = clone_array(*other.array, resource());
+      } else {
+        other.array->refs.fetch_add(1, std::memory_order_relaxed);
+        this->array = other.array;
+      }
+      break;
+    }
+    retype(other.type()); // Only once the contents are there, as cloning might throw.
+  }
+
+  void value::unshare() {
+    switch (type()) {
+    case value_type::object:
+      if (object.shared()) {
+        detail::object_map copy = object.clone(resource());
+        object.release(resource());
+        object = copy;
+      } else if (object.cached_hash() != 0) {
+        object.cache_hash(0); // Might have been cached while the object was shared.
+      }
+      break;
+    case value_type::array:
+      if (array->refs.load(std::memory_order_acquire) != 1) {
+        detail::array_rep* copy = clone_array(*array, resource());
+        release_array(array, resource());
+        array = copy;
+      } else if (array->hash.load(std::memory_order_relaxed) != 0) {
+        array->hash.store(0, std::memory_order_relaxed);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  void value::leak() {
+    switch (type()) {
+    case value_type::object:
+      assert(!object.shared());
+      object.leak();
+      break;
+    case value_type::array:
+      assert(array->refs.load(std::memory_order_relaxed) == 1);
+      array->leaked = true;
+      break;
+    default:
+      break;
+    }
+  }
+
+  bool value::leaked() const {
+    switch (type()) {
+    case value_type::object: return object.leaked();
+    case value_type::array:  return array->leaked;
+    default:                 return false;
+    }
+  }
+
+  value::value(const value& other) : value(other, std::pmr::get_default_resource()) {}
+
+  value::value(const value& other, std::pmr::memory_resource* _resource) : tagged(value_type::null, _resource), number(0) {
+    if (*resource() == *other.resource()) {
+      share(other);
+      return;
+    }
+    init(other.type());
+    try {
+      from(other);
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  value::value(value&& other) noexcept : tagged(value_type::null, other.resource()), number(0) {
+    take(std::move(other));
+  }
+
+  value::value(value&& other, std::pmr::memory_resource* _resource) : tagged(value_type::null, _resource), number(0) {
+    if (*resource() == *other.resource()) {
+      take(std::move(other));
+    } else {
+      init(other.type());
+      try {
+        from(other);
+      } catch (...) {
+        release();
+        throw;
+      }
     }
   }
 
@@ -130,90 +708,134 @@ namespace json {
     if (this == &other) {
       return *this;
     }
+    value copy(other, resource()); // Keeps this value intact if copying throws.
     release();
-    type = other.type;
-    from(other);
+    take(std::move(copy));
     return *this;
   }
 
   value& value::operator=(value&& other) {
-    release();
-    type = other.type;
-    switch (other.type) {
-    case value_type::null:    break;
-    case value_type::number:  this->number  = other.number;  break; 
-    case value_type::boolean: this->boolean = other.boolean; break; 
-    case value_type::string:  new (&string) std::string(std::move(other.string)); break;
-    case value_type::object:  new (&object) std::unordered_map<std::string, std::unique_ptr<value>>(std::move(other.object)); break;
-    case value_type::array:   new (&array) std::vector<std::unique_ptr<value>>(std::move(other.array));  break;
+    if (this == &other) {
+      return *this;
+    }
+    if (*resource() != *other.resource()) {
+      return *this = static_cast<const value&>(other);
     }
+    value moved(std::move(other)); // Other might be a part of this value.
+    release();
+    take(std::move(moved));
     return *this;
   }
 
-  value::value() : type(value_type::null) {}
-  value::value(std::nullptr_t) : type(value_type::null) {}
-  value::value(const std::string& str) : type(value_type::string), string(str) {}
-  value::value(const char* str) : type(value_type::string), string(str) {}
-  value::value(double val) : type(value_type::number), number(val) {}
-  value::value(bool val) : type(value_type::boolean), boolean(val) {}
-  value::value(std::initializer_list<std::pair<std::string, value>> pairs) : type(value_type::object), object() {
-    for (auto el : pairs) {
-      object[el.first] = std::make_unique<value>(el.second);
+  value::value() : tagged(value_type::null, std::pmr::get_default_resource()), number(0) {}
+  value::value(std::nullptr_t) : value() {}
+  value::value(const std::string& str) : value(std::string_view(str)) {}
+  value::value(const char* str) : value(std::string_view(str)) {}
+  value::value(std::string_view str) : value(str, std::pmr::get_default_resource()) {}
+  value::value(std::string_view str, std::pmr::memory_resource* _resource) : tagged(value_type::string, _resource), string(nullptr) {
+    if (!str.empty()) {
+      string = detail::string_rep::make(str, _resource);
     }
   }
-
-  value::value(value_type t) : type(t) {
-    switch(t) {
-    case value_type::null:    break;
-    case value_type::boolean: boolean = false; break;
-    case value_type::number:  number = 0;      break; 
-    case value_type::string:  new (&string) std::string(); break;
-    case value_type::object:  new (&object) std::unordered_map<std::string, std::unique_ptr<value>>(); break;
-    case value_type::array:   new (&array) std::vector<std::unique_ptr<value>>(); break;
-    default:
-      throw json_error("Unknown [value_type=" + utils::to_string(t) + "] encountered during construction.");
+  value::value(double val) : tagged(value_type::number, std::pmr::get_default_resource()), number(val) {}
+  value::value(bool val) : tagged(value_type::boolean, std::pmr::get_default_resource()), boolean(val) {}
+  // Elements of initializer list cannot be moved from, but copies share their contents (unless resources differ).
+  value::value(std::initializer_list<std::pair<std::string, value>> pairs) : value(value_type::object) {
+    object.reserve(pairs.size(), resource());
+    for (const auto& el : pairs) {
+      assign(el.first, value(el.second, resource()));
     }
   }
 
-  value& value::operator=(const char* str) {
-    // TODO: think about exception safety
+  value::value(value_type t) : value(t, std::pmr::get_default_resource()) {}
+  value::value(value_type t, std::pmr::memory_resource* _resource) : tagged(value_type::null, _resource), number(0) {
+    init(t);
+  }
+
+  value& value::operator=(std::string_view str) {
+    if (type() == value_type::string && string && str.size() <= string->capacity && !str.empty() && string->refs.load(std::memory_order_acquire) == 1) {
+      std::memmove(string->data(), str.data(), str.size()); // Might be assigned a part of itself.
+      string->size = uint32_t(str.size());
+      return *this;
+    }
+    // Keeps this value intact if allocation throws.
+    detail::string_rep* replacement = str.empty() ? nullptr : detail::string_rep::make(str, resource());
     release();
-    type = value_type::string;
-    new (&string) std::string(str);
+    retype(value_type::string);
+    string = replacement;
     return *this;
   }
 
+  value& value::operator=(const std::string& str) {
+    return *this = std::string_view(str);
+  }
+
+  value& value::operator=(const char* str) {
+    return *this = std::string_view(str);
+  }
+
   value& value::operator=(bool a) {
     release();
-    type = value_type::boolean;
+    retype(value_type::boolean);
     boolean = a;
     return *this;
   }
 
   value& value::operator=(double d) {
     release();
-    type = value_type::number;
+    retype(value_type::number);
     number = d;
     return *this;
   }
 
   value& value::operator=(std::nullptr_t) {
     release();
-    type = value_type::null;
-    number = 0;
     return *this;
   }
 
+  // Text of a string value.
+  static std::string_view text_of(const detail::string_rep* rep) {
+    return rep ? rep->text() : std::string_view();
+  }
+
+  // Content hash of given array stored by json::hash, see object_map::cached_hash.
+  static uint64_t cached_hash(const detail::array_rep* array) {
+    return array->leaked ? 0 : array->hash.load(std::memory_order_relaxed);
+  }
+
+  // False only if both hashes are cached and they differ.
+  static bool same_hash(uint64_t hash, uint64_t other) {
+    return hash == 0 || other == 0 || hash == other;
+  }
+
   bool value::operator==(const value& other) const {
-    if (type != other.type) return false;
+    if (type() != other.type()) return false;
 
-    switch (type) {
+    switch (type()) {
     case value_type::null:    return true;
     case value_type::boolean: return boolean == other.boolean;
     case value_type::number:  return number == other.number;
-    case value_type::string:  return string == other.string;
-    case value_type::object:  return object == other.object;
-    case value_type::array:   return array == other.array;
+    case value_type::string:  return string == other.string || text_of(string) == text_of(other.string);
+    case value_type::object:
+      if (object.same(other.object)) {
+        return true;
+      }
+      if (object.size() != other.object.size() || !same_hash(object.cached_hash(), other.object.cached_hash())) {
+        return false;
+      }
+      // Order of entries doesn't matter.
+      return std::all_of(object.begin(), object.end(), [&other](const detail::object_map::entry& el) {
+        const size_t position = other.object.find(el.first.text());
+        return position != detail::object_map::npos && other.object[position].second == el.second;
+      });
+    case value_type::array:
+      if (array == other.array) {
+        return true;
+      }
+      if (array->size() != other.array->size() || !same_hash(cached_hash(array), cached_hash(other.array))) {
+        return false;
+      }
+      return std::equal(array->begin(), array->end(), other.array->begin());
     default:
       // We shouldn't end up here, but we might, since enum class can be
       // operated upon via static_cast<int> + bitwise operations + cast back and C++ standard
@@ -228,37 +850,38 @@ namespace json {
   }
 
   bool value::operator==(std::nullptr_t) const {
-    return type == value_type::null;
+    return type() == value_type::null;
   }
   bool value::operator!=(std::nullptr_t) const {
-    return type != value_type::null;
+    return type() != value_type::null;
   }
 
-  bool value::is_null() const { return type == value_type::null; }
-  bool value::is_string() const { return type == value_type::string; }
-  bool value::is_number() const { return type == value_type::number; }
-  bool value::is_boolean() const { return type == value_type::boolean; }
-  bool value::is_object() const { return type == value_type::object; }
-  bool value::is_array() const { return type == value_type::array; }
-  value_type value::get_type() const { return type; }
+  bool value::is_null() const { return type() == value_type::null; }
+  bool value::is_string() const { return type() == value_type::string; }
+  bool value::is_number() const { return type() == value_type::number; }
+  bool value::is_boolean() const { return type() == value_type::boolean; }
+  bool value::is_object() const { return type() == value_type::object; }
+  bool value::is_array() const { return type() == value_type::array; }
+  value_type value::get_type() const { return type(); }
+  std::pmr::memory_resource* value::get_resource() const { return resource(); }
 
-  std::string value::as_string() const { should_be(*this, value_type::string); return string; }
+  std::string value::as_string() const { should_be(*this, value_type::string); return std::string(text_of(string)); }
   double      value::as_number() const { should_be(*this, value_type::number); return number; }
   bool        value::as_boolean() const { should_be(*this, value_type::boolean); return boolean; }
 
   std::string value::serialize() const {
-    switch (type) {
+    switch (type()) {
     case value_type::null:    return "null";
     case value_type::boolean: return boolean ? "true" : "false";
     case value_type::number:  return utils::to_string(number);
-    case value_type::string:  return escape(string);
+    case value_type::string:  return escape(text_of(string));
     case value_type::object: {
       std::stringstream ss;
       std::string separator = "";
       ss << "{";
       for (const auto& el: object) {
         ss << separator;
-        ss << escape(el.first) << ":" << el.second->serialize();
+        ss << escape(el.first.text()) << ":" << el.second.serialize();
         separator = ",";
       }
       ss << "}";
@@ -268,9 +891,9 @@ namespace json {
       std::stringstream ss;
       std::string separator = "";
       ss << "[";
-      for (const auto& el: array) {
+      for (const auto& el: *array) {
         ss << separator;
-        ss << el->serialize();
+        ss << el.serialize();
         separator = ",";
       }
       ss << "]";
@@ -283,103 +906,181 @@ namespace json {
     }
   }
 
-  bool value::has(const std::string& key) const { should_be(*this, value_type::object); return object.find(key) != object.end(); }
-  value& value::operator[](const std::string& key) {
+  bool value::has(std::string_view key) const { should_be(*this, value_type::object); return object.find(key) != detail::object_map::npos; }
+  bool value::has(const json::key& key) const { should_be(*this, value_type::object); return object.find(key.block) != detail::object_map::npos; }
+  value& value::operator[](std::string_view key) {
+    should_be(*this, value_type::object);
+    unshare();
+    size_t position = object.find(key);
+    if (position == detail::object_map::npos) {
+      position = object.append(key, value(value_type::null, resource()), resource());
+    }
+    leak();
+    return object[position].second;
+  }
+  value& value::operator[](const json::key& key) {
     should_be(*this, value_type::object);
-    auto element = object.emplace(key, std::make_unique<value>());
-    return *(element.first->second);
+    unshare();
+    size_t position = object.find(key.block);
+    if (position == detail::object_map::npos) {
+      // Key of the document this value lives in is shared.
+      position = key.arena == resource() ? object.append(key.block, value(value_type::null, resource()), resource())
+                                         : object.append(key.text(), value(value_type::null, resource()), resource());
+    }
+    leak();
+    return object[position].second;
+  }
+  value& value::insert_or_assign(std::string_view key, const value& other) {
+    return insert_or_assign(key, value(other, resource()));
+  }
+  value& value::insert_or_assign(std::string_view key, value&& other) {
+    const size_t position = assign(key, std::move(other));
+    leak();
+    return object[position].second;
+  }
+  size_t value::assign(std::string_view key, value&& other) {
+    should_be(*this, value_type::object);
+    unshare();
+    const bool adopted = other.leaked();
+    size_t position = object.find(key);
+    if (position == detail::object_map::npos) {
+      position = object.append(key, value(std::move(other), resource()), resource());
+    } else {
+      object[position].second = std::move(other);
+    }
+    if (adopted) {
+      leak();
+    }
+    return position;
+  }
+  value& value::insert_or_assign(const json::key& key, const value& other) {
+    return insert_or_assign(key, value(other, resource()));
+  }
+  value& value::insert_or_assign(const json::key& key, value&& other) {
+    const size_t position = assign(key, std::move(other));
+    leak();
+    return object[position].second;
+  }
+  size_t value::assign(const json::key& key, value&& other) {
+    should_be(*this, value_type::object);
+    unshare();
+    const bool adopted = other.leaked();
+    size_t position = object.find(key.block);
+    if (position == detail::object_map::npos) {
+      // Key of the document this value lives in is shared.
+      position = key.arena == resource() ? object.append(key.block, value(std::move(other), resource()), resource())
+                                         : object.append(key.text(), value(std::move(other), resource()), resource());
+    } else {
+      object[position].second = std::move(other);
+    }
+    if (adopted) {
+      leak();
+    }
+    return position;
+  }
+  void value::remove(std::string_view key) {
+    should_be(*this, value_type::object);
+    unshare();
+    const size_t position = object.find(key);
+    if (position != detail::object_map::npos) {
+      object.erase(position, resource());
+    }
+  }
+  void value::remove(const json::key& key) {
+    should_be(*this, value_type::object);
+    unshare();
+    const size_t position = object.find(key.block);
+    if (position != detail::object_map::npos) {
+      object.erase(position, resource());
+    }
   }
-  void value::remove(const std::string& key) { should_be(*this, value_type::object); object.erase(key); }
 
   value& value::operator[](size_t index) {
     should_be(*this, value_type::array);
-    if (index >= array.size()) {
-      throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array.size()) + "]");
+    unshare();
+    if (index >= array->size()) {
+      throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array->size()) + "]");
+    }
+    leak();
+    return (*array)[index];
+  }
+  size_t value::push(const value& other) {
+    return push(value(other, resource()));
+  }
+  size_t value::push(value&& other) {
+    should_be(*this, value_type::array);
+    unshare();
+    const bool adopted = other.leaked();
+    array->push_back(value(std::move(other), resource()));
+    if (adopted) {
+      leak();
     }
-    return *(array[index]);
+    return array->size() - 1;
   }
-  size_t value::push(value other) { should_be(*this, value_type::array); array.push_back(std::make_unique<value>(other)); return array.size() - 1; }
   size_t value::remove(size_t index) {
     should_be(*this, value_type::array);
-    if (index >= array.size()) {
-      throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array.size()) + "]");
+    unshare();
+    if (index >= array->size()) {
+      throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array->size()) + "]");
     }
-    array.erase(array.begin() + index);
-    return array.size();
+    array->erase(array->begin() + index);
+    return array->size();
   }
 
   size_t value::size() const {
-    switch (type) {
+    switch (type()) {
     case value_type::array:
-      return array.size();
+      return array->size();
     case value_type::object:
       return object.size();
     default:
-      throw json_error("Can only query size of object and array nodes, this node type is [type=" + utils::to_string(type) + "]");
+      throw json_error("Can only query size of object and array nodes, this node type is [type=" + utils::to_string(type()) + "]");
     }
   }
 
   bool value::empty() const {
-    switch (type) {
+    switch (type()) {
     case value_type::array:
-      return array.empty();
+      return array->empty();
     case value_type::object:
       return object.empty();
     default:
-      throw json_error("Can only query emptiness of object and array nodes, this node type is [type=" + utils::to_string(type) + "]");
+      throw json_error("Can only query emptiness of object and array nodes, this node type is [type=" + utils::to_string(type()) + "]");
+    }
+  }
+
+  void value::reserve(size_t count) {
+    unshare();
+    switch (type()) {
+    case value_type::array:
+      array->reserve(count);
+      break;
+    case value_type::object:
+      object.reserve(count, resource());
+      break;
+    default:
+      throw json_error("Can only reserve room in object and array nodes, this node type is [type=" + utils::to_string(type()) + "]");
     }
   }
 
   void swap(value& lhs, value& rhs) {
     using std::swap;
-    if (lhs.type == rhs.type) {
-      switch (lhs.type) {
-      case value_type::null:    break;
-      case value_type::boolean: swap(lhs.boolean, rhs.boolean);
-      case value_type::number:  swap(lhs.number, rhs.number);
-      case value_type::string:  swap(lhs.string, rhs.string);
-      case value_type::object:  swap(lhs.object, rhs.object);
-      case value_type::array:   swap(lhs.array, rhs.array);
-      }
+    // Contents allocated from different resources cannot be exchanged, only copied.
+    if (*lhs.resource() == *rhs.resource()) {
+      const value_type type = lhs.type();
+      lhs.retype(rhs.type());
+      rhs.retype(type);
+      // Payload is trivially copyable, whichever member is active.
+      char payload[sizeof(lhs.number)];
+      std::memcpy(payload, &lhs.number, sizeof(payload));
+      std::memcpy(&lhs.number, &rhs.number, sizeof(payload));
+      std::memcpy(&rhs.number, payload, sizeof(payload));
       return;
     }
 
     std::swap(lhs, rhs); // This swap will use move construction and two move assignments
   }
 
-  value::object_iterator::object_iterator(const value::object_iterator& other) : source(other.source) {
-    if (other.value_reference) {
-      value_reference = std::make_unique<object_entry>(*other.value_reference);
-    }
-  }
-  value::object_iterator::object_iterator(const std::unordered_map<std::string, std::unique_ptr<value>>::const_iterator& src) : source(src), value_reference(nullptr) {
-    source = src; 
-  }
-  value::object_iterator::~object_iterator() = default;
-  value::object_iterator& value::object_iterator::operator++() {
-    ++source;
-    return *this;
-  }
-  bool value::object_iterator::operator==(value::object_iterator other) const { return source == other.source; }
-  bool value::object_iterator::operator!=(value::object_iterator other) const { return source != other.source; }
-  value::object_iterator::reference value::object_iterator::operator*() const { 
-    value_reference = std::make_unique<value::object_entry>(source->first, *(source->second));
-    return *value_reference;
-  }
-
-  value::array_iterator::array_iterator(const array_iterator& other) : source(other.source) {}
-  value::array_iterator::array_iterator(const std::vector<std::unique_ptr<value>>::const_iterator& src) : source(src) {}
-  value::array_iterator::~array_iterator() = default; 
-  value::array_iterator& value::array_iterator::operator++() {
-    ++source;
-    return *this;
-  }
-  bool value::array_iterator::operator==(value::array_iterator other) const { return source == other.source; }
-  bool value::array_iterator::operator!=(value::array_iterator other) const { return source != other.source; }
-  value::array_iterator::reference value::array_iterator::operator*() const {
-    return *(*source);
-  }
-
   array_value value::as_array() {
     should_be(*this, value_type::array);
     return array_value(*this);
@@ -388,11 +1089,79 @@ namespace json {
     should_be(*this, value_type::object);
     return object_value(*this);
   }
+  const_array_value value::as_array() const {
+    should_be(*this, value_type::array);
+    return const_array_value(*this);
+  }
+  const_object_value value::as_object() const {
+    should_be(*this, value_type::object);
+    return const_object_value(*this);
+  }
   
   std::ostream& operator<<(std::ostream& os, const value& val) {
     return os << val.serialize();
   }
 
+  // Final step of splitmix64, spreads every bit of the input over the whole result.
+  static uint64_t mix(uint64_t hash) {
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+  }
+
+  // Containers are hashed once while their storage is shared and not leaked, since nothing can change it in place then.
+  size_t hash(const value& val) {
+    // Seeds keep values of different types apart, zero is left for "not cached".
+    const uint64_t seed = uint64_t(val.type()) + 1;
+    switch (val.type()) {
+    case value_type::null:
+      return mix(seed);
+    case value_type::boolean:
+      return mix(seed << 32 | uint64_t(val.boolean));
+    case value_type::number: {
+      const double number = val.number == 0 ? 0.0 : val.number; // -0 is equal to 0.
+      uint64_t bits;
+      std::memcpy(&bits, &number, sizeof(bits));
+      return mix(mix(seed) ^ bits);
+    }
+    case value_type::string:
+      return mix(seed << 32 | detail::hash_key(text_of(val.string)));
+    case value_type::object: {
+      if (const uint64_t cached = val.object.cached_hash()) {
+        return cached;
+      }
+      // Sum of entry hashes doesn't depend on their order.
+      uint64_t sum = mix(seed ^ val.object.size());
+      for (size_t i = 0; i < val.object.size(); ++i) {
+        sum += mix(uint64_t(val.object.key_hash(i)) << 32 ^ hash(val.object[i].second));
+      }
+      const uint64_t result = std::max<uint64_t>(mix(sum), 1);
+      if (val.object.shared()) {
+        val.object.cache_hash(result);
+      }
+      return result;
+    }
+    case value_type::array: {
+      if (const uint64_t cached = cached_hash(val.array)) {
+        return cached;
+      }
+      uint64_t result = mix(seed ^ val.array->size());
+      for (const auto& el : *val.array) {
+        result = mix(result + hash(el));
+      }
+      result = std::max<uint64_t>(result, 1);
+      if (val.array->refs.load(std::memory_order_acquire) != 1 && !val.array->leaked) {
+        val.array->hash.store(result, std::memory_order_relaxed);
+      }
+      return result;
+    }
+    default:
+      // See comment at operator==
+      assert(false);
+      return 0;
+    }
+  }
+
   array_value::array_value(value& _value) : wrapped_value(_value) {}
   array_value::array_value(array_value&& other) : wrapped_value(other.wrapped_value) {} // Not `move` per se
   array_value& array_value::operator=(array_value&& other) {
@@ -402,22 +1171,33 @@ namespace json {
 
   value& array_value::operator[](size_t index) {
     // Since we'd like to avoid runtime checks:
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
+    assert(wrapped_value.type() == value_type::array);
+    wrapped_value.unshare();
+    auto& array = *wrapped_value.array;
     if (index >= array.size()) {
       throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array.size()) + "]");
     }
-    return *(array[index]);
+    wrapped_value.leak();
+    return array[index];
+  }
+  size_t array_value::push(const value& other) {
+    return push(value(other, wrapped_value.resource()));
   }
-  size_t array_value::push(value other) {
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
-    array.push_back(std::make_unique<value>(other));
+  size_t array_value::push(value&& other) {
+    assert(wrapped_value.type() == value_type::array);
+    wrapped_value.unshare();
+    auto& array = *wrapped_value.array;
+    const bool adopted = other.leaked();
+    array.push_back(value(std::move(other), wrapped_value.resource()));
+    if (adopted) {
+      wrapped_value.leak();
+    }
     return array.size() - 1;
   }
   size_t array_value::remove(size_t index) {
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
+    assert(wrapped_value.type() == value_type::array);
+    wrapped_value.unshare();
+    auto& array = *wrapped_value.array;
     if (index >= array.size()) {
       throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array.size()) + "]");
     }
@@ -425,24 +1205,40 @@ namespace json {
     return array.size();
   }
   size_t array_value::size() const {
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
+    assert(wrapped_value.type() == value_type::array);
+    auto& array = *wrapped_value.array;
     return array.size();
   }
   bool   array_value::empty() const {
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
+    assert(wrapped_value.type() == value_type::array);
+    auto& array = *wrapped_value.array;
     return array.empty();
   }
-  value::array_iterator array_value::begin() {
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
-    return value::array_iterator(array.begin());
+  array_value::iterator array_value::begin() {
+    assert(wrapped_value.type() == value_type::array);
+    wrapped_value.unshare();
+    wrapped_value.leak();
+    auto& array = *wrapped_value.array;
+    return iterator(array.data());
+  }
+  array_value::iterator array_value::end() {
+    assert(wrapped_value.type() == value_type::array);
+    wrapped_value.unshare();
+    wrapped_value.leak();
+    auto& array = *wrapped_value.array;
+    return iterator(array.data() + array.size());
+  }
+  array_value::const_iterator array_value::begin() const { return cbegin(); }
+  array_value::const_iterator array_value::end() const { return cend(); }
+  array_value::const_iterator array_value::cbegin() const {
+    assert(wrapped_value.type() == value_type::array);
+    const auto& array = *wrapped_value.array;
+    return const_iterator(array.data());
   }
-  value::array_iterator array_value::end() {
-    assert(wrapped_value.type == value_type::array);
-    auto& array = wrapped_value.array;
-    return value::array_iterator(array.end());
+  array_value::const_iterator array_value::cend() const {
+    assert(wrapped_value.type() == value_type::array);
+    const auto& array = *wrapped_value.array;
+    return const_iterator(array.data() + array.size());
   }
 
   object_value::object_value(value& _value) : wrapped_value(_value) {}
@@ -452,40 +1248,279 @@ namespace json {
     return *this;
   }
 
-  bool   object_value::has(const std::string& key) const {
-    assert(wrapped_value.type == value_type::object);
-    auto& object = wrapped_value.object;
-    return object.find(key) != object.end();
+  bool   object_value::has(std::string_view key) const {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.object.find(key) != detail::object_map::npos;
+  }
+  bool   object_value::has(const json::key& key) const {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.object.find(key.block) != detail::object_map::npos;
+  }
+  value& object_value::operator[](std::string_view key) {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value[key];
   }
-  value& object_value::operator[](const std::string& key) {
-    assert(wrapped_value.type == value_type::object);
+  value& object_value::operator[](const json::key& key) {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value[key];
+  }
+  value& object_value::insert_or_assign(std::string_view key, const value& other) {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.insert_or_assign(key, other);
+  }
+  value& object_value::insert_or_assign(std::string_view key, value&& other) {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.insert_or_assign(key, std::move(other));
+  }
+  value& object_value::insert_or_assign(const json::key& key, const value& other) {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.insert_or_assign(key, other);
+  }
+  value& object_value::insert_or_assign(const json::key& key, value&& other) {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.insert_or_assign(key, std::move(other));
+  }
+  void   object_value::remove(std::string_view key) {
+    assert(wrapped_value.type() == value_type::object);
+    wrapped_value.unshare();
     auto& object = wrapped_value.object;
-    auto element = object.emplace(key, std::make_unique<value>());
-    return *(element.first->second);
+    const size_t position = object.find(key);
+    if (position != detail::object_map::npos) {
+      object.erase(position, wrapped_value.resource());
+    }
   }
-  void   object_value::remove(const std::string& key) {
-    assert(wrapped_value.type == value_type::object);
+  void   object_value::remove(const json::key& key) {
+    assert(wrapped_value.type() == value_type::object);
+    wrapped_value.unshare();
     auto& object = wrapped_value.object;
-    object.erase(key);
+    const size_t position = object.find(key.block);
+    if (position != detail::object_map::npos) {
+      object.erase(position, wrapped_value.resource());
+    }
   }
   size_t object_value::size() const {
-    assert(wrapped_value.type == value_type::object);
+    assert(wrapped_value.type() == value_type::object);
     auto& object = wrapped_value.object;
     return object.size();
   }
   bool   object_value::empty() const {
-    assert(wrapped_value.type == value_type::object);
+    assert(wrapped_value.type() == value_type::object);
     auto& object = wrapped_value.object;
     return object.empty();
   }
-  value::object_iterator object_value::begin() {
-    assert(wrapped_value.type == value_type::object);
+  object_value::iterator object_value::begin() {
+    assert(wrapped_value.type() == value_type::object);
+    wrapped_value.unshare();
+    wrapped_value.leak();
     auto& object = wrapped_value.object;
-    return value::object_iterator(object.begin());
+    return iterator(object.begin());
   }
-  value::object_iterator object_value::end() {
-    assert(wrapped_value.type == value_type::object);
+  object_value::iterator object_value::end() {
+    assert(wrapped_value.type() == value_type::object);
+    wrapped_value.unshare();
+    wrapped_value.leak();
     auto& object = wrapped_value.object;
-    return value::object_iterator(object.end());
+    return iterator(object.end());
+  }
+  object_value::const_iterator object_value::begin() const { return cbegin(); }
+  object_value::const_iterator object_value::end() const { return cend(); }
+  object_value::const_iterator object_value::cbegin() const {
+    assert(wrapped_value.type() == value_type::object);
+    const auto& object = wrapped_value.object;
+    return const_iterator(object.begin());
+  }
+  object_value::const_iterator object_value::cend() const {
+    assert(wrapped_value.type() == value_type::object);
+    const auto& object = wrapped_value.object;
+    return const_iterator(object.end());
+  }
+
+  const_array_value::const_array_value(const value& _value) : wrapped_value(_value) {}
+  const_array_value::const_array_value(const_array_value&& other) : wrapped_value(other.wrapped_value) {}
+
+  const value& const_array_value::operator[](size_t index) const {
+    assert(wrapped_value.type() == value_type::array);
+    const auto& array = *wrapped_value.array;
+    if (index >= array.size()) {
+      throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(array.size()) + "]");
+    }
+    return array[index];
+  }
+  size_t const_array_value::size() const {
+    assert(wrapped_value.type() == value_type::array);
+    return wrapped_value.array->size();
+  }
+  bool   const_array_value::empty() const {
+    assert(wrapped_value.type() == value_type::array);
+    return wrapped_value.array->empty();
+  }
+  const_array_value::const_iterator const_array_value::begin() const { return cbegin(); }
+  const_array_value::const_iterator const_array_value::end() const { return cend(); }
+  const_array_value::const_iterator const_array_value::cbegin() const {
+    assert(wrapped_value.type() == value_type::array);
+    const auto& array = *wrapped_value.array;
+    return const_iterator(array.data());
+  }
+  const_array_value::const_iterator const_array_value::cend() const {
+    assert(wrapped_value.type() == value_type::array);
+    const auto& array = *wrapped_value.array;
+    return const_iterator(array.data() + array.size());
+  }
+
+  const_object_value::const_object_value(const value& _value) : wrapped_value(_value) {}
+  const_object_value::const_object_value(const_object_value&& other) : wrapped_value(other.wrapped_value) {}
+
+  // Throws if the key is not there.
+  static const value& entry_at(const detail::object_map& object, size_t position, std::string_view key) {
+    if (position == detail::object_map::npos) {
+      throw json_error("Object has no [key=" + std::string(key) + "]");
+    }
+    return object[position].second;
+  }
+
+  bool   const_object_value::has(std::string_view key) const {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.object.find(key) != detail::object_map::npos;
+  }
+  bool   const_object_value::has(const json::key& key) const {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.object.find(key.block) != detail::object_map::npos;
+  }
+  const value& const_object_value::operator[](std::string_view key) const {
+    assert(wrapped_value.type() == value_type::object);
+    return entry_at(wrapped_value.object, wrapped_value.object.find(key), key);
+  }
+  const value& const_object_value::operator[](const json::key& key) const {
+    assert(wrapped_value.type() == value_type::object);
+    return entry_at(wrapped_value.object, wrapped_value.object.find(key.block), key.text());
+  }
+  size_t const_object_value::size() const {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.object.size();
+  }
+  bool   const_object_value::empty() const {
+    assert(wrapped_value.type() == value_type::object);
+    return wrapped_value.object.empty();
+  }
+  const_object_value::const_iterator const_object_value::begin() const { return cbegin(); }
+  const_object_value::const_iterator const_object_value::end() const { return cend(); }
+  const_object_value::const_iterator const_object_value::cbegin() const {
+    assert(wrapped_value.type() == value_type::object);
+    return const_iterator(wrapped_value.object.begin());
+  }
+  const_object_value::const_iterator const_object_value::cend() const {
+    assert(wrapped_value.type() == value_type::object);
+    return const_iterator(wrapped_value.object.end());
+  }
+
+  // Open-addressing set of immutable texts, lives in the arena together with its slots.
+  template<typename Block>
+  class intern_set {
+    std::pmr::vector<std::pair<uint32_t, Block*>> slots; // Hash and text, null if free. At most a half is taken.
+    size_t count;
+
+  public:
+    explicit intern_set(std::pmr::memory_resource* arena) : slots(64, {0, nullptr}, arena), count(0) {}
+
+    // Returns text equal to given one, making it with `make(text, hash, arena)` if there is none yet.
+    template<typename Make>
+    Block* intern(std::string_view text, Make make) {
+      const uint32_t hash = detail::hash_key(text);
+      size_t slot = hash & (slots.size() - 1);
+      for (; slots[slot].second != nullptr; slot = (slot + 1) & (slots.size() - 1)) {
+        if (slots[slot].first == hash && slots[slot].second->text() == text) {
+          return slots[slot].second;
+        }
+      }
+      Block* block = make(text, hash, slots.get_allocator().resource());
+      slots[slot] = {hash, block};
+      if (++count * 2 > slots.size()) {
+        grow();
+      }
+      return block;
+    }
+
+  private:
+    void grow() {
+      std::pmr::vector<std::pair<uint32_t, Block*>> old(slots.size() * 2, {0, nullptr}, slots.get_allocator().resource());
+      old.swap(slots);
+      for (const auto& entry : old) {
+        if (entry.second != nullptr) {
+          size_t slot = entry.first & (slots.size() - 1);
+          while (slots[slot].second != nullptr) {
+            slot = (slot + 1) & (slots.size() - 1);
+          }
+          slots[slot] = entry;
+        }
+      }
+    }
+  };
+
+  class document::intern_table {
+  public:
+    explicit intern_table(std::pmr::memory_resource* arena) : keys(arena), strings(arena) {}
+
+    intern_set<const detail::key_block> keys;
+    intern_set<detail::string_rep> strings;
+  };
+
+  document::document(std::pmr::memory_resource* upstream)
+    : upstream_resource(upstream), arena(std::make_unique<std::pmr::monotonic_buffer_resource>(upstream)), root_value(nullptr), interned(nullptr) {
+    clear();
+  }
+
+  document::document(void* buffer, size_t size, std::pmr::memory_resource* upstream)
+    : upstream_resource(upstream), arena(std::make_unique<std::pmr::monotonic_buffer_resource>(buffer, size, upstream)), root_value(nullptr), interned(nullptr) {
+    clear();
+  }
+
+  document::document(document&& other) noexcept
+    : upstream_resource(other.upstream_resource), arena(std::move(other.arena)), root_value(other.root_value), interned(other.interned) {
+    other.root_value = nullptr;
+    other.interned = nullptr;
+  }
+
+  document& document::operator=(document&& other) noexcept {
+    if (this != &other) {
+      upstream_resource = other.upstream_resource;
+      arena = std::move(other.arena);
+      root_value = other.root_value;
+      interned = other.interned;
+      other.root_value = nullptr;
+      other.interned = nullptr;
+    }
+    return *this;
+  }
+
+  // Everything, including the root, lives in the arena, so the tree isn't destroyed: arena's destructor releases it.
+  document::~document() = default;
+
+  value& document::root() { return *root_value; }
+  const value& document::root() const { return *root_value; }
+  std::pmr::memory_resource* document::resource() const { return arena.get(); }
+
+  void document::clear() {
+    if (!arena) {
+      arena = std::make_unique<std::pmr::monotonic_buffer_resource>(upstream_resource); // Moved from.
+    }
+    root_value = nullptr; // Nothing dangles if allocation below throws.
+    interned = nullptr;
+    arena->release();
+    root_value = new (arena->allocate(sizeof(value), alignof(value))) value(value_type::null, arena.get());
+    interned = new (arena->allocate(sizeof(intern_table), alignof(intern_table))) intern_table(arena.get());
+  }
+
+  const detail::key_block* document::intern_key(std::string_view text) {
+    return interned->keys.intern(text, detail::key_block::make);
+  }
+
+  key document::intern(std::string_view text) {
+    return key(intern_key(text), arena.get());
+  }
+
+  detail::string_rep* document::intern_string(std::string_view text) {
+    return interned->strings.intern(text, [](std::string_view text, uint32_t, std::pmr::memory_resource* arena) {
+      return detail::string_rep::make(text, arena, true);
+    });
   }
 }
@@ -1,13 +1,19 @@
 #ifndef _JSON_H_
 #define _JSON_H_
 
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <iterator>
+#include <memory_resource>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace json {
 
@@ -22,19 +28,299 @@ namespace json {
   };
 
   // Forward declarations for array_value and object_value
+  struct value;
   class array_value;
   class object_value;
+  class const_array_value;
+  class const_object_value;
+
+  namespace parser {
+    class tree_builder;
+    class tree_updater;
+  }
+
+  namespace frozen {
+    class builder;
+    class value;
+  }
+
+  namespace detail {
+    // Object key: its hash and length, followed by the text in the same allocation. Keys are immutable, so objects
+    // of a document share them (see document::intern).
+    struct key_block {
+      uint32_t hash;
+      uint32_t size;
+
+      const char*      data() const { return reinterpret_cast<const char*>(this + 1); }
+      std::string_view text() const { return std::string_view(data(), size); }
+
+      // Allocates a key with given text and its hash from given resource. Throws json_error if key is longer than 4GB.
+      static const key_block* make(std::string_view, uint32_t hash, std::pmr::memory_resource*);
+      static void destroy(const key_block*, std::pmr::memory_resource*) noexcept;
+      // Static block of the empty key, never destroyed.
+      static const key_block* empty() noexcept;
+    };
+
+    // String of a value: its length and capacity, followed by the characters in the same allocation. Copies of a
+    // value share the string, which is released by the last of them. Strings interned by a document have zero
+    // capacity and are never written to or released, so they are not counted.
+    struct string_rep {
+      uint32_t size;
+      uint32_t capacity;
+      std::atomic<uint32_t> refs;
+
+      char*            data()       { return reinterpret_cast<char*>(this + 1); }
+      const char*      data() const { return reinterpret_cast<const char*>(this + 1); }
+      std::string_view text() const { return std::string_view(data(), size); }
+
+      // Allocates a copy of given text from given resource, shared one if capacity is zero. Throws json_error if
+      // text is longer than 4GB.
+      static string_rep* make(std::string_view, std::pmr::memory_resource*, bool shared = false);
+      // Adds a reference to given string and returns it.
+      static string_rep* share(string_rep*) noexcept;
+      // Drops a reference to given string, which is freed once the last one is gone.
+      static void release(string_rep*, std::pmr::memory_resource*) noexcept;
+    };
+
+    // Key of an object entry: short keys are kept inline, longer ones are key_blocks owned by the entry or shared
+    // ones (see object_map::append).
+    class object_key {
+    public:
+      static constexpr size_t inline_size = 15;
+
+      // Copy of given text, allocated from given resource if it's too long to be inline.
+      object_key(std::string_view, uint32_t hash, std::pmr::memory_resource*);
+      // Refers to given block, see object_map::append.
+      explicit object_key(const key_block*);
+
+      std::string_view text() const;
+      // Keys of iterated entries read like the text, e.g. `entry.first == "id"` or `os << entry.first`.
+      operator std::string_view() const { return text(); }
+      const char* data() const { return text().data(); }
+      size_t      size() const { return text().size(); }
+      // Block that holds the key, nullptr if it is inline.
+      const key_block* block() const;
+      // Same key for another entry: owned block is copied, allocated from given resource.
+      object_key copy(std::pmr::memory_resource*) const;
+      // Releases owned block, if any. Keys are not released on destruction, object_map does that.
+      void release(std::pmr::memory_resource*) noexcept;
+
+    private:
+      // Only the object rearranges its keys, so that iterated entries can't get another key.
+      object_key& operator=(const object_key&) = default;
+      friend class object_map;
+
+      static constexpr uint8_t owned  = 0xFF;
+      static constexpr uint8_t shared = 0xFE;
+
+      // Text followed by its length or a block pointer followed by `owned` or `shared` in the last byte.
+      alignas(const key_block*) char bytes[inline_size + 1];
+    };
+    inline bool operator==(const object_key& lhs, const object_key& rhs) { return lhs.text() == rhs.text(); }
+    inline bool operator==(const object_key& lhs, std::string_view rhs)  { return lhs.text() == rhs; }
+    inline bool operator==(std::string_view lhs, const object_key& rhs)  { return lhs == rhs.text(); }
+    inline bool operator!=(const object_key& lhs, const object_key& rhs) { return !(lhs == rhs); }
+    inline bool operator!=(const object_key& lhs, std::string_view rhs)  { return !(lhs == rhs); }
+    inline bool operator!=(std::string_view lhs, const object_key& rhs)  { return !(lhs == rhs); }
+    inline std::ostream& operator<<(std::ostream& os, const object_key& key) { return os << key.text(); }
+
+    // Contents of an object: entries are kept in insertion order in a single array. Small objects are searched
+    // linearly, comparing vectorized key hashes first. Once there are more than `indexed_size` entries, an
+    // open-addressing hash index of entry positions is maintained as well. Entries are addressed by their
+    // position, which changes only when an entry before it is removed.
+    // It's a handle to a single allocation holding everything (nothing at all while the object is empty). The handle
+    // doesn't know its resource: value owning it passes the resource in, so that object takes just a pointer.
+    // Copies of a value share the allocation, which is released by the last of them. Only an object that is not
+    // shared can be modified, see value::unshare, and once references to its entries are handed out it's never shared
+    // again, see value::leak.
+    class object_map {
+    public:
+      using entry          = std::pair<object_key, value>;
+      using iterator       = entry*;
+      using const_iterator = const entry*;
+
+      static constexpr size_t indexed_size = 32;
+      static constexpr size_t npos = size_t(-1);
+
+      object_map() noexcept : storage(nullptr) {}
+
+      size_t size() const  { return storage ? storage->size : 0; }
+      bool   empty() const { return size() == 0; }
+      // Defined once value is complete.
+      entry&         operator[](size_t position);
+      const entry&   operator[](size_t position) const;
+      iterator       begin();
+      iterator       end();
+      const_iterator begin() const;
+      const_iterator end()   const;
+
+      // Position of the entry with given key or npos.
+      size_t find(std::string_view key) const;
+      // Same as above, keys are compared by address first.
+      size_t find(const key_block* key) const;
+      // Adds an entry at the end and returns its position. Key should not be present yet, value should use the
+      // resource of the object.
+      size_t append(std::string_view key, value&&, std::pmr::memory_resource*);
+      // Same as above, but given key is shared instead of copied. The object takes no ownership, so that the key
+      // should outlive it and the resource of the object should not need its memory back: the object must live in
+      // the arena of the document that interned the key.
+      size_t append(const key_block* key, value&&, std::pmr::memory_resource*);
+      // Removes entry at given position, entries after it move one position back.
+      void erase(size_t position, std::pmr::memory_resource*);
+      // Removes all entries starting with given position.
+      void truncate(size_t size, std::pmr::memory_resource*);
+      // Exchanges positions of two entries.
+      void swap(size_t first, size_t second);
+      void reserve(size_t, std::pmr::memory_resource*);
+      // Drops this reference to the storage, releasing entries and the storage if it was the last one.
+      void release(std::pmr::memory_resource*) noexcept;
+      // Another handle to the same storage.
+      object_map share() const noexcept;
+      // True if other handles refer to the same storage.
+      bool shared() const { return storage && storage->refs.load(std::memory_order_acquire) != 1; }
+      // Marks the storage as one that is never shared, see value::leak. Copies are made with clone() instead.
+      void leak() { if (storage) storage->leaked = true; }
+      bool leaked() const { return storage && storage->leaked; }
+      bool same(const object_map& other) const { return storage == other.storage; }
+      // Content hash stored by json::hash, zero if there is none. Storing zero drops it. Leaked storage can change
+      // through references to its entries, so its hash is neither stored nor trusted.
+      uint64_t cached_hash() const { return storage && !storage->leaked ? storage->hash.load(std::memory_order_relaxed) : 0; }
+      void     cache_hash(uint64_t hash) const { if (storage && !storage->leaked) storage->hash.store(hash, std::memory_order_relaxed); }
+      // Hash of the key at given position.
+      uint32_t key_hash(size_t position) const { return hashes()[position]; }
+      // Copy of the storage for this handle alone, values of the copy share their payloads with the ones here.
+      object_map clone(std::pmr::memory_resource*) const;
+
+    private:
+      // Allocation starts with this header, followed by `capacity` entries, then `slots` index slots (entry position
+      // + 1, zero if free) and `capacity` key hashes.
+      struct alignas(void*) header {
+        uint32_t size;
+        uint32_t capacity;
+        uint32_t slots; // Zero if object is not indexed.
+        std::atomic<uint32_t> refs;
+        std::atomic<uint64_t> hash;
+        bool leaked;
+      };
+
+      entry*    entries() const { return reinterpret_cast<entry*>(storage + 1); }
+      uint32_t* index()   const;
+      uint32_t* hashes()  const { return index() + storage->slots; }
+      // Adds entry with given hash, updating the index.
+      size_t push(object_key key, uint32_t hash, value&&, std::pmr::memory_resource*);
+      // Moves everything to a new allocation with given capacity and number of index slots.
+      void relocate(size_t capacity, size_t slots, std::pmr::memory_resource*);
+      // Fills index slots for all entries.
+      void fill_index();
+      // Index slot that refers to the entry at given position.
+      uint32_t* slot_of(size_t position) const;
+      // Empty storage for given capacity and number of index slots.
+      static header* allocate(size_t capacity, size_t slots, std::pmr::memory_resource*);
+      // Number of index slots appropriate for given number of entries.
+      static size_t slots_for(size_t size);
+
+      header* storage;
+    };
+  }
+
+  namespace detail {
+    // Elements of an array, shared by copies of a value just like object_map.
+    struct array_rep : std::pmr::vector<value> {
+      using std::pmr::vector<value>::vector;
+      std::atomic<uint32_t> refs{1};
+      bool leaked{false};            // Same as object_map::leaked.
+      std::atomic<uint64_t> hash{0}; // Same as object_map::cached_hash.
+    };
+
+    // Resource of a value together with the type of the value. Resources are polymorphic, hence pointer-aligned:
+    // where that leaves three low bits free (64-bit targets) the type is kept in them, otherwise in a byte of its own.
+    template<bool packed>
+    class typed_resource;
+
+    template<>
+    class typed_resource<true> {
+    public:
+      typed_resource(value_type t, std::pmr::memory_resource* r) : bits(reinterpret_cast<uintptr_t>(r) | uintptr_t(t)) {}
+      value_type                 type() const     { return value_type(bits & type_mask); }
+      std::pmr::memory_resource* resource() const { return reinterpret_cast<std::pmr::memory_resource*>(bits & ~type_mask); }
+      void                       retype(value_type t) { bits = (bits & ~type_mask) | uintptr_t(t); }
+
+    private:
+      static constexpr uintptr_t type_mask = 7;
+      uintptr_t bits;
+    };
+
+    template<>
+    class typed_resource<false> {
+    public:
+      typed_resource(value_type t, std::pmr::memory_resource* r) : pointer(r), tag(uint8_t(t)) {}
+      value_type                 type() const     { return value_type(tag); }
+      std::pmr::memory_resource* resource() const { return pointer; }
+      void                       retype(value_type t) { tag = uint8_t(t); }
+
+    private:
+      std::pmr::memory_resource* pointer;
+      uint8_t tag;
+    };
+
+    using value_tag = typed_resource<(alignof(std::pmr::memory_resource) >= 8)>;
+  }
+
+  // Object key with its hash computed once, for lookups repeated over many objects (see value::operator[]). Key
+  // made by document::intern refers to the text stored in the document: it's found in objects of the document by
+  // address and is only valid until the document is cleared or destroyed. Moved-from key is the empty one.
+  class key {
+  public:
+    explicit key(std::string_view);
+    key(const key&);
+    key(key&&) noexcept;
+    key& operator=(const key&);
+    key& operator=(key&&) noexcept;
+    ~key();
+
+    std::string_view text() const { return block->text(); }
+    uint32_t         hash() const { return block->hash; }
+
+  private:
+    friend class document;
+    friend struct value;
+    friend class object_value;
+    friend class const_object_value;
+
+    key(const detail::key_block* interned, std::pmr::memory_resource* _arena) : block(interned), arena(_arena) {}
+
+    const detail::key_block* block;
+    std::pmr::memory_resource* arena; // Arena of the document that interned the key, null if key owns the block.
+  };
 
   // The structure that encapsulates JSON value. Relies on runtime checks to
   // check validity of operations. Have two proxies - for objects and for arrays operations.
+  // Value takes 16 bytes: the payload (a scalar or a pointer to out-of-line string or container) and the resource
+  // with the type. Children are stored inline: arrays are vectors of values and objects are vectors of entries (see
+  // detail::object_map), which keep their insertion order. Like with std::vector, adding children to a container
+  // might invalidate references to its other children. Moved-from value is null.
+  // Strings and container storage are allocated from the memory resource of the value (the default one
+  // unless given explicitly), children share the resource of their parent. Resource sticks to the value the way
+  // allocator sticks to std::pmr containers: assignment keeps it (moving from a value with another resource copies)
+  // and copy construction uses the default resource. Copying within the same resource is O(1): strings and containers
+  // are shared by reference counting and a container is copied (one level deep) only when it's about to be modified
+  // through one of its owners. A container whose children were handed out by mutable reference or iterator is copied
+  // (one level deep) right away instead, so that writes through such reference never reach copies of it.
   struct value {
     // Constructor and assignment stuff
     ~value();
     value(const value&);
-    value(value&&);
+    value(value&&) noexcept;
     value& operator=(const value&);
     value& operator=(value&&);
 
+    // Same as above, but the new value (and everything inside it) uses given resource. Moving from a value with
+    // another resource copies.
+    value(const value&, std::pmr::memory_resource*);
+    value(value&&, std::pmr::memory_resource*);
+    value(value_type, std::pmr::memory_resource*);
+    value(std::string_view, std::pmr::memory_resource*);
+
     // Custom constructors from primitives
     template<typename T>
     value(T) = delete;
@@ -42,6 +328,7 @@ namespace json {
     value(std::nullptr_t);                                       // Constructs null value explicitly
     value(const std::string&);                                   // Constructs string value
     value(const char*);                                          // Constructs string value (this one is needed thanks to `wonderful` preference of bool-constructor to std::string one).
+    value(std::string_view);                                     // Constructs string value
     value(bool);                                                 // Constructs boolean node
     value(double);                                               // Constructs numeric value
     value(float v) : value((double)v) {}                         // Constructs numeric value
@@ -58,12 +345,14 @@ namespace json {
     // 2. Same for `val = "str"`...
     // 3. Presence of operator=(bool) breaks `val = 0.0` if it's not also overloaded...
     value& operator=(const std::string&);
+    value& operator=(std::string_view);   // Reuses storage if this value is a string already
     value& operator=(const char*);        // Overload of char* assignment
     value& operator=(bool);               // Overload of bool assignment
     value& operator=(double);             // Overload of number assignment
     value& operator=(std::nullptr_t);     // Overload of null assignment (to be able to write obj["key"] = nullptr a-la JavaScript)
 
-    // Comparison operators
+    // Comparison operators. Objects are equal if they have the same entries in any order. Containers or strings shared
+    // by copies are equal without being compared (even if there are NaNs inside).
     bool operator==(const value&)   const;
     bool operator!=(const value&)   const;
     bool operator==(std::nullptr_t) const; // This and following methods are to simplify comparison frequently
@@ -77,6 +366,8 @@ namespace json {
     bool       is_object()  const;
     bool       is_array()   const;
     value_type get_type()   const;
+    // Resource that strings, containers and children of this value are allocated from.
+    std::pmr::memory_resource* get_resource() const;
 
     // Retrieving values
     std::string as_string()  const;
@@ -88,82 +379,238 @@ namespace json {
 
     // Object-related stuff
     // Returns true if object contains a key.
-    bool has(const std::string&) const;
-    // Returns reference to value stored in given key. Mimics the behaviour of std::unordered_map[key]
+    bool has(std::string_view) const;
+    bool has(const key&) const;
+    // Returns reference to value stored in given key. Mimics the behaviour of std::map[key]
     // in that it returns either a reference to the stored value or associates default value with key and returns reference to that.
-    value& operator[](const std::string&);
-    // Removed key association from object. If no key exists - does nothing.
-    void remove(const std::string&);
-
-    using object_entry = std::pair<const std::string&, value&>;
-    struct object_iterator : public std::iterator<std::forward_iterator_tag, object_entry> {
-      object_iterator(const object_iterator& other);
-      object_iterator(const std::unordered_map<std::string, std::unique_ptr<value>>::const_iterator&);
-      ~object_iterator();
-      object_iterator& operator++();
-      object_iterator operator++(int) {object_iterator res = *this; ++(*this); return res;}
-      bool operator==(object_iterator other) const;
-      bool operator!=(object_iterator other) const;
-      reference operator*() const;
+    // Nothing is allocated if the key is there already.
+    value& operator[](std::string_view);
+    value& operator[](const key&);
+    // Associates key with given value, replacing the previously associated one. Value is moved in or copied with
+    // the resource of this value (which only shares its contents if resources are equal).
+    value& insert_or_assign(std::string_view, const value&);
+    value& insert_or_assign(std::string_view, value&&);
+    value& insert_or_assign(const key&, const value&);
+    value& insert_or_assign(const key&, value&&);
+    // Adds an entry made from given initializer (anything value is constructible from) unless there is one with given
+    // key already, like std::map::try_emplace. Returns reference to the value stored in the key. Strings and
+    // containers are made with the resource of this value right away, so nothing is copied into it.
+    template<typename T>
+    value& emplace(std::string_view key, T&& init) {
+      if (has(key)) {
+        return (*this)[key];
+      }
+      // Made before the entry is added, as initializer may refer to an entry of this very object.
+      return insert_or_assign(key, adopt(std::forward<T>(init)));
+    }
+    // Removed key association from object, keeping order of other entries. If no key exists - does nothing.
+    void remove(std::string_view);
+    void remove(const key&);
+
+    // Entries are pairs of the key and the value, stored in the object and bound to by reference:
+    // `for (auto& [key, val] : object.as_object())`. Key reads like a std::string_view and can't be reassigned.
+    using object_entry       = detail::object_map::entry;
+    using const_object_entry = const detail::object_map::entry;
+
+    // Iterators over object entries, Value is either `value` or `const value`. Just a pointer to the entry.
+    template<typename Value>
+    struct basic_object_iterator {
+      using entry_type = std::conditional_t<std::is_const_v<Value>, const_object_entry, object_entry>;
+
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type        = object_entry;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = entry_type*;
+      using reference         = entry_type&;
+
+      basic_object_iterator() : source(nullptr) {}
+      explicit basic_object_iterator(entry_type* _source) : source(_source) {}
+      // Mutable iterator converts to the const one.
+      template<typename Other, typename = std::enable_if_t<std::is_const_v<Value> && !std::is_const_v<Other>>>
+      basic_object_iterator(const basic_object_iterator<Other>& other) : source(other.source) {}
+
+      reference operator*() const { return *source; }
+      pointer operator->() const { return source; }
+      reference operator[](difference_type n) const { return source[n]; }
+
+      basic_object_iterator& operator++() { ++source; return *this; }
+      basic_object_iterator& operator--() { --source; return *this; }
+      basic_object_iterator operator++(int) { basic_object_iterator res = *this; ++source; return res; }
+      basic_object_iterator operator--(int) { basic_object_iterator res = *this; --source; return res; }
+      basic_object_iterator& operator+=(difference_type n) { source += n; return *this; }
+      basic_object_iterator& operator-=(difference_type n) { source -= n; return *this; }
+      basic_object_iterator operator+(difference_type n) const { return basic_object_iterator(source + n); }
+      basic_object_iterator operator-(difference_type n) const { return basic_object_iterator(source - n); }
+      friend basic_object_iterator operator+(difference_type n, const basic_object_iterator& it) { return it + n; }
+      difference_type operator-(const basic_object_iterator& other) const { return source - other.source; }
+
+      bool operator==(const basic_object_iterator& other) const { return source == other.source; }
+      bool operator!=(const basic_object_iterator& other) const { return source != other.source; }
+      bool operator<(const basic_object_iterator& other)  const { return source < other.source; }
+      bool operator>(const basic_object_iterator& other)  const { return source > other.source; }
+      bool operator<=(const basic_object_iterator& other) const { return source <= other.source; }
+      bool operator>=(const basic_object_iterator& other) const { return source >= other.source; }
+
     private:
-      std::unordered_map<std::string, std::unique_ptr<value>>::const_iterator source;
-      mutable std::unique_ptr<object_entry> value_reference;
+      template<typename> friend struct basic_object_iterator;
+      entry_type* source;
     };
+    using object_iterator       = basic_object_iterator<value>;
+    using const_object_iterator = basic_object_iterator<const value>;
 
     // Array-related stuff
 
     // Returns reference to a value stored in JSON array. Mimics behaviour of
     // std::vector.at(): if index is out of bounds, raises an exception of type out_of_range
     value& operator[](size_t);
-    // Pushes value into the array, returning size of the array (and the index of pushed element, coincidentally)
-    size_t push(value);
+    // Pushes value into the array, returning size of the array (and the index of pushed element, coincidentally).
+    // Value is moved in or copied, just like with insert_or_assign().
+    size_t push(const value&);
+    size_t push(value&&);
+    // Appends a value made from given initializer, just like emplace() for objects does, and returns reference to it.
+    template<typename T>
+    value& emplace(T&& init) {
+      return (*this)[push(adopt(std::forward<T>(init)))];
+    }
     // Removes the element at given index, returning new size of array. If index is out
     // of array's bounds, throws an out_of_range exception.
     size_t remove(size_t);
 
-    struct array_iterator : public std::iterator<std::forward_iterator_tag, value> {
-      array_iterator(const array_iterator& other);
-      array_iterator(const std::vector<std::unique_ptr<value>>::const_iterator&);
-      ~array_iterator();
-      array_iterator& operator++();
-      array_iterator operator++(int) {array_iterator res = *this; ++(*this); return res;}
-      bool operator==(array_iterator other) const;
-      bool operator!=(array_iterator other) const;
-      reference operator*() const;
+    // Iterators over array elements, Value is either `value` or `const value`. Just a pointer to the element.
+    template<typename Value>
+    struct basic_array_iterator {
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type        = std::remove_const_t<Value>;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = Value*;
+      using reference         = Value&;
+
+      basic_array_iterator() : source(nullptr) {}
+      explicit basic_array_iterator(Value* _source) : source(_source) {}
+      // Mutable iterator converts to the const one.
+      template<typename Other, typename = std::enable_if_t<std::is_const_v<Value> && !std::is_const_v<Other>>>
+      basic_array_iterator(const basic_array_iterator<Other>& other) : source(other.source) {}
+
+      reference operator*() const { return *source; }
+      pointer operator->() const { return source; }
+      reference operator[](difference_type n) const { return source[n]; }
+
+      basic_array_iterator& operator++() { ++source; return *this; }
+      basic_array_iterator& operator--() { --source; return *this; }
+      basic_array_iterator operator++(int) { basic_array_iterator res = *this; ++source; return res; }
+      basic_array_iterator operator--(int) { basic_array_iterator res = *this; --source; return res; }
+      basic_array_iterator& operator+=(difference_type n) { source += n; return *this; }
+      basic_array_iterator& operator-=(difference_type n) { source -= n; return *this; }
+      basic_array_iterator operator+(difference_type n) const { return basic_array_iterator(source + n); }
+      basic_array_iterator operator-(difference_type n) const { return basic_array_iterator(source - n); }
+      friend basic_array_iterator operator+(difference_type n, const basic_array_iterator& it) { return it + n; }
+      difference_type operator-(const basic_array_iterator& other) const { return source - other.source; }
+
+      bool operator==(const basic_array_iterator& other) const { return source == other.source; }
+      bool operator!=(const basic_array_iterator& other) const { return source != other.source; }
+      bool operator<(const basic_array_iterator& other)  const { return source < other.source; }
+      bool operator>(const basic_array_iterator& other)  const { return source > other.source; }
+      bool operator<=(const basic_array_iterator& other) const { return source <= other.source; }
+      bool operator>=(const basic_array_iterator& other) const { return source >= other.source; }
+
     private:
-      std::vector<std::unique_ptr<value>>::const_iterator source;
+      template<typename> friend struct basic_array_iterator;
+      Value* source;
     };
+    using array_iterator       = basic_array_iterator<value>;
+    using const_array_iterator = basic_array_iterator<const value>;
 
     // For object and arrays returns the number of entries.
     size_t size() const;
     // Returns true if object/array is empty
     bool empty() const;
+    // Makes room for given number of object/array entries, so that adding them doesn't reallocate or rehash.
+    void reserve(size_t);
 
     friend void swap(value& lhs, value& rhs);
+    friend size_t hash(const value&);
     friend class array_value;
     friend class object_value;
+    friend class const_array_value;
+    friend class const_object_value;
+    friend class document;
+    friend class parser::tree_builder;
+    friend class parser::tree_updater;
+    friend class frozen::builder;
+    friend class frozen::value;
 
     // Following two methods return views to this value that is only
     // valid while the value exists. This allows us to avoid copy and have
-    // these objects cost little.
-    array_value  as_array();
-    object_value as_object();
+    // these objects cost little. Views of a const value are read-only.
+    array_value        as_array();
+    object_value       as_object();
+    const_array_value  as_array()  const;
+    const_object_value as_object() const;
   private:
+    // Constructs empty contents of given type, assumes that nothing is held at the moment.
+    void init(value_type);
     // Populates this instance from another one.
     void from(const value&);
+    // Takes contents of another value, assumes that nothing is held at the moment and that resources are equal.
+    void take(value&&) noexcept;
     // Releases currently held value. Sets type to null. noexcept explained in .cpp.
     void release() noexcept;
-    // Either a Boost variant or C++17 variant here is more proper.
-    value_type type;
+    // Shares contents of another value, assumes that nothing is held at the moment and that resources are equal.
+    // Leaked container is copied one level deep instead.
+    void share(const value&);
+    // Stores given value in given key the way insert_or_assign does, returns position of the entry. Nothing is handed
+    // out, so the object is not leaked (see leak).
+    size_t assign(std::string_view, value&&);
+    size_t assign(const key&, value&&);
+    // Makes a child for this value from given initializer, with the resource of this value.
+    template<typename T>
+    value adopt(T&& init) const {
+      using type = std::decay_t<T>;
+      if constexpr (std::is_same_v<type, value> || std::is_same_v<type, value_type>) {
+        return value(std::forward<T>(init), resource());
+      } else if constexpr (std::is_same_v<type, std::nullptr_t>) {
+        return value(value_type::null, resource());
+      } else if constexpr (std::is_convertible_v<T, std::string_view>) {
+        return value(std::string_view(init), resource());
+      } else {
+        return value(value(init), resource()); // Scalars take no memory, only the resource is set.
+      }
+    }
+    // Makes container of this value exclusive to it before it's modified: shared one is copied (its children are
+    // shared by the copy). Strings are checked right when they are written.
+    void unshare();
+    // Marks container of this value, exclusive to it already, as never shared again. Called whenever a mutable
+    // reference to a child or a mutable iterator is handed out, as the container could be shared by the time it's
+    // written through (the way leaked copy-on-write std::string used to work).
+    void leak();
+    // True if container of this value has been leaked. A parent that adopts such a value leaks too, or copies of
+    // the parent would share the child that is still written through.
+    bool leaked() const;
+    // Type is kept together with the resource, see detail::typed_resource.
+    value_type                 type() const     { return tagged.type(); }
+    std::pmr::memory_resource* resource() const { return tagged.resource(); }
+    void                       retype(value_type t) { tagged.retype(t); }
+
+    detail::value_tag tagged;
     union {
-      double                                                  number;
-      std::string                                             string;
-      bool                                                    boolean;
-      std::unordered_map<std::string, std::unique_ptr<value>> object;
-      std::vector<std::unique_ptr<value>>                     array;
+      double                   number;
+      bool                     boolean;
+      detail::string_rep*      string;  // Null for an empty string.
+      detail::object_map       object;
+      detail::array_rep*       array;
     };
   };
 
+  namespace detail {
+    inline object_map::entry&       object_map::operator[](size_t position)       { return entries()[position]; }
+    inline const object_map::entry& object_map::operator[](size_t position) const { return entries()[position]; }
+    inline object_map::iterator       object_map::begin()       { return storage ? entries() : nullptr; }
+    inline object_map::iterator       object_map::end()         { return storage ? entries() + storage->size : nullptr; }
+    inline object_map::const_iterator object_map::begin() const { return storage ? entries() : nullptr; }
+    inline object_map::const_iterator object_map::end()   const { return storage ? entries() + storage->size : nullptr; }
+    inline uint32_t* object_map::index() const { return reinterpret_cast<uint32_t*>(entries() + storage->capacity); }
+  }
+
   // This class provides array-specific interface to aleviate some runtime checks and provide compatibility
   // with STL. This is actually a facade for plain value, but with runtime checks removed and more appropriate method names.
   // The lifetime of the array_value is the same as of the value it was constructed with.
@@ -185,12 +632,22 @@ namespace json {
     array_value& operator=(array_value&&);
     // Docs for methods below are the same as for value methods.
     value& operator[](size_t);
-    size_t push(value);
+    size_t push(const value&);
+    size_t push(value&&);
     size_t remove(size_t);
     size_t size() const;
     bool   empty() const;
-    value::array_iterator begin();
-    value::array_iterator end();
+    template<typename T>
+    value& emplace(T&& init) { return wrapped_value.emplace(std::forward<T>(init)); }
+
+    using iterator       = value::array_iterator;
+    using const_iterator = value::const_array_iterator;
+    iterator       begin();
+    iterator       end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
   };
 
   // This class provides object-specific interface to aleviate some runtime checks and provide compatibility
@@ -213,17 +670,137 @@ namespace json {
     object_value(object_value&&);
     object_value& operator=(object_value&&);
     // Docs for methods below are the same as for value methods.
-    bool   has(const std::string&) const;
-    value& operator[](const std::string&);
-    void   remove(const std::string&);
+    bool   has(std::string_view) const;
+    bool   has(const key&) const;
+    value& operator[](std::string_view);
+    value& operator[](const key&);
+    value& insert_or_assign(std::string_view, const value&);
+    value& insert_or_assign(std::string_view, value&&);
+    value& insert_or_assign(const key&, const value&);
+    value& insert_or_assign(const key&, value&&);
+    void   remove(std::string_view);
+    void   remove(const key&);
+    size_t size() const;
+    bool   empty() const;
+    template<typename T>
+    value& emplace(std::string_view key, T&& init) { return wrapped_value.emplace(key, std::forward<T>(init)); }
+
+    using iterator       = value::object_iterator;
+    using const_iterator = value::const_object_iterator;
+    iterator       begin();
+    iterator       end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+  };
+
+  // Read-only counterparts of the facades above, for const values. Same notes apply.
+  class const_array_value {
+    const value& wrapped_value;
+    const_array_value(const value& _value);
+    friend struct value;
+
+    const_array_value(const const_array_value&)            = delete;
+    const_array_value& operator=(const const_array_value&) = delete;
+  public:
+    const_array_value(const_array_value&&);
+    // Docs for methods below are the same as for value methods.
+    const value& operator[](size_t) const;
     size_t size() const;
     bool   empty() const;
-    value::object_iterator begin();
-    value::object_iterator end();
+
+    using iterator       = value::const_array_iterator;
+    using const_iterator = value::const_array_iterator;
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+  };
+
+  class const_object_value {
+    const value& wrapped_value;
+    const_object_value(const value& _value);
+    friend struct value;
+
+    const_object_value(const const_object_value&)            = delete;
+    const_object_value& operator=(const const_object_value&) = delete;
+  public:
+    const_object_value(const_object_value&&);
+    // Docs for methods below are the same as for value methods, except that there is nothing to insert into, so
+    // a missing key throws json::json_error.
+    bool         has(std::string_view) const;
+    bool         has(const key&) const;
+    const value& operator[](std::string_view) const;
+    const value& operator[](const key&) const;
+    size_t size() const;
+    bool   empty() const;
+
+    using iterator       = value::const_object_iterator;
+    using const_iterator = value::const_object_iterator;
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+  };
+
+  // Owner of a tree whose nodes, strings and container storage are all carved from a monotonic arena, so nothing
+  // is freed one by one: the tree is never walked on teardown, the arena just returns its blocks upstream at once.
+  // Values moved out of the document keep pointing into the arena, copy them if they should outlive the document.
+  class document {
+    class intern_table;
+
+    std::pmr::memory_resource* upstream_resource;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    value* root_value;    // Lives in the arena and is never destroyed,
+    intern_table* interned; // just like the table of distinct keys and short strings.
+
+    // Returns shared key or string with given text, see intern.
+    const detail::key_block* intern_key(std::string_view);
+    detail::string_rep*      intern_string(std::string_view);
+    friend class parser::tree_builder;
+  public:
+    // Strings up to this size are stored once per document when parsing into it.
+    static constexpr size_t short_string_size = 16;
+
+    // Arena draws its blocks from given resource.
+    explicit document(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    // Arena starts with given buffer (which should outlive the document) and goes upstream once it is used up.
+    document(void* buffer, size_t size, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    // Moved-from document holds nothing: it can only be destroyed, assigned to or cleared, which makes it a fresh one
+    // drawing from the same upstream resource.
+    document(document&&) noexcept;
+    document& operator=(document&&) noexcept;
+    ~document();
+
+    // Top level value, null in a fresh document. Values assigned into the tree are copied into the arena.
+    value&       root();
+    const value& root() const;
+    // The arena, to build values right in it.
+    std::pmr::memory_resource* resource() const;
+    // Drops the tree and releases the arena at once, so that document can be reused.
+    void clear();
+    // Returns the key with given text, stored once per document: parsing into the document keeps every distinct
+    // key once, shared by all its objects, so that looking it up compares addresses. Adding the key to an object of
+    // the document shares it as well.
+    json::key intern(std::string_view);
   };
 
   // Overload for outputting to stream (internally works via serialize).
   std::ostream& operator<<(std::ostream&, const value&);
+
+  // Hash of the contents of a value, consistent with operator==: equal values have equal hashes, whatever the order of
+  // their object entries. Hash of a container is cached in its storage while the storage is shared by copies of the
+  // value and none of its children were handed out by mutable reference (so it cannot change until it's copied by a
+  // modification), which also lets operator== tell such containers apart by their hashes without comparing them.
+  size_t hash(const value&);
+}
+
+namespace std {
+  template<>
+  struct hash<json::value> {
+    size_t operator()(const json::value& val) const { return json::hash(val); }
+  };
 }
 
 #endif
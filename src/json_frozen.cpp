@@ -0,0 +1,315 @@
+#include "json_frozen.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace json {
+  namespace frozen {
+
+    void should_be(const value& val, value_type t) {
+      if (val.get_type() != t) {
+        throw json_error("Value of [type=" + utils::to_string(val.get_type()) + "] is treated as value of [type=" + utils::to_string(t) + "]");
+      }
+    }
+
+    bool value::is_null()    const { return at->type == value_type::null; }
+    bool value::is_string()  const { return at->type == value_type::string; }
+    bool value::is_number()  const { return at->type == value_type::number; }
+    bool value::is_boolean() const { return at->type == value_type::boolean; }
+    bool value::is_object()  const { return at->type == value_type::object; }
+    bool value::is_array()   const { return at->type == value_type::array; }
+    value_type value::get_type() const { return at->type; }
+
+    std::string_view value::as_string() const {
+      should_be(*this, value_type::string);
+      return std::string_view(source->strings.data() + at->offset, at->size);
+    }
+    double value::as_number()  const { should_be(*this, value_type::number); return at->number; }
+    bool   value::as_boolean() const { should_be(*this, value_type::boolean); return at->boolean; }
+
+    // Binary search over entry indices sorted by key.
+    size_t value::find(std::string_view key) const {
+      const uint32_t* entries = table();
+      const uint32_t* sorted = entries + 3 * size_t(at->size);
+      auto key_of = [this, entries](uint32_t index) {
+        const uint32_t* entry = entries + 3 * size_t(index);
+        return std::string_view(source->strings.data() + entry[0], entry[1]);
+      };
+      const uint32_t* found = std::lower_bound(sorted, sorted + at->size, key, [&key_of](uint32_t index, std::string_view key) {
+        return key_of(index) < key;
+      });
+      return found != sorted + at->size && key_of(*found) == key ? *found : at->size;
+    }
+
+    bool value::has(std::string_view key) const {
+      should_be(*this, value_type::object);
+      return find(key) != at->size;
+    }
+
+    value value::operator[](std::string_view key) const {
+      should_be(*this, value_type::object);
+      const size_t index = find(key);
+      if (index == at->size) {
+        throw json_error("Object has no [key=" + std::string(key) + "]");
+      }
+      return value(source, &source->nodes[table()[3 * index + 2]]);
+    }
+
+    value value::operator[](size_t index) const {
+      should_be(*this, value_type::array);
+      if (index >= at->size) {
+        throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(at->size) + "]");
+      }
+      return value(source, &source->nodes[table()[index]]);
+    }
+
+    size_t value::size() const {
+      switch (at->type) {
+      case value_type::array:
+      case value_type::object:
+        return at->size;
+      default:
+        throw json_error("Can only query size of object and array nodes, this node type is [type=" + utils::to_string(at->type) + "]");
+      }
+    }
+
+    bool value::empty() const {
+      switch (at->type) {
+      case value_type::array:
+      case value_type::object:
+        return at->size == 0;
+      default:
+        throw json_error("Can only query emptiness of object and array nodes, this node type is [type=" + utils::to_string(at->type) + "]");
+      }
+    }
+
+    json::value value::materialize(std::pmr::memory_resource* resource) const {
+      json::value result(at->type, resource);
+      switch (at->type) {
+      case value_type::null:    break;
+      case value_type::number:  result = at->number;  break;
+      case value_type::boolean: result = at->boolean; break;
+      case value_type::string:  result = as_string(); break;
+      case value_type::object:
+        result.reserve(at->size);
+        for (const auto& entry : as_object()) {
+          result.assign(entry.first, entry.second.materialize(resource));
+        }
+        break;
+      case value_type::array:
+        result.reserve(at->size);
+        for (auto element : as_array()) {
+          result.push(element.materialize(resource));
+        }
+        break;
+      }
+      return result;
+    }
+
+    std::string value::serialize() const {
+      return materialize().serialize();
+    }
+
+    array_value value::as_array() const {
+      should_be(*this, value_type::array);
+      return array_value(*this);
+    }
+
+    object_value value::as_object() const {
+      should_be(*this, value_type::object);
+      return object_value(*this);
+    }
+
+    value::object_iterator::reference value::object_iterator::operator*() const {
+      return object_entry(std::string_view(source->strings.data() + entry[0], entry[1]), value(source, &source->nodes[entry[2]]));
+    }
+
+    value::array_iterator array_value::begin() const {
+      return value::array_iterator(wrapped_value.source, wrapped_value.table());
+    }
+
+    value::array_iterator array_value::end() const {
+      return value::array_iterator(wrapped_value.source, wrapped_value.table() + size());
+    }
+
+    value::object_iterator object_value::begin() const {
+      return value::object_iterator(wrapped_value.source, wrapped_value.table());
+    }
+
+    value::object_iterator object_value::end() const {
+      return value::object_iterator(wrapped_value.source, wrapped_value.table() + 3 * size());
+    }
+
+    document::document() : document(builder().result()) {}
+
+    value document::root() const {
+      return value(contents.get(), contents->nodes.data());
+    }
+
+    builder::builder() : target(std::make_unique<detail::tape>()), frames(), children(), keys(), order() {}
+
+    void builder::start() {
+      target->nodes.clear();
+      target->tables.clear();
+      target->strings.clear();
+      frames.clear();
+      children.clear();
+      keys.clear();
+    }
+
+    detail::node& builder::emit(value_type type, uint32_t size) {
+      const size_t position = target->nodes.size();
+      if (position >= UINT32_MAX) {
+        throw json_error("Document of more than [size=" + utils::to_string(position) + "] values cannot be frozen.");
+      }
+      if (!frames.empty()) {
+        children.push_back(uint32_t(position));
+      }
+      detail::node& result = target->nodes.emplace_back();
+      result.type = type;
+      result.size = size;
+      result.offset = 0;
+      return result;
+    }
+
+    uint32_t builder::store(std::string_view text) {
+      const size_t offset = target->strings.size();
+      if (text.size() > UINT32_MAX - offset) {
+        throw json_error("Strings of a document cannot take more than 4GB to be frozen.");
+      }
+      target->strings.append(text);
+      return uint32_t(offset);
+    }
+
+    void builder::add(std::string_view str) {
+      const uint32_t offset = store(str);
+      emit(value_type::string, uint32_t(str.size())).offset = offset;
+    }
+    void builder::add(double num)     { emit(value_type::number, 0).number = num; }
+    void builder::add(bool flag)      { emit(value_type::boolean, 0).boolean = flag; }
+    void builder::add(std::nullptr_t) { emit(value_type::null, 0); }
+
+    void builder::key(std::string_view str) {
+      keys.emplace_back(store(str), uint32_t(str.size()));
+    }
+
+    void builder::open(value_type type) {
+      const uint32_t position = uint32_t(target->nodes.size());
+      emit(type, 0);
+      frames.push_back(frame{position, children.size(), keys.size()});
+    }
+
+    void builder::close(value_type type) {
+      const frame current = frames.back();
+      frames.pop_back();
+      if (type == value_type::array) {
+        close_array(current);
+      } else {
+        close_object(current);
+      }
+      children.resize(current.first_child);
+      keys.resize(current.first_key);
+    }
+
+    void builder::close_array(const frame& current) {
+      auto& tables = target->tables;
+      detail::node& array = target->nodes[current.node];
+      array.offset = tables.size();
+      array.size = uint32_t(children.size() - current.first_child);
+      tables.insert(tables.end(), children.begin() + current.first_child, children.end());
+    }
+
+    void builder::close_object(const frame& current) {
+      const uint32_t* child = children.data() + current.first_child;
+      const std::pair<uint32_t, uint32_t>* key = keys.data() + current.first_key;
+      size_t count = children.size() - current.first_child;
+      auto key_of = [this, &key](uint32_t index) { return std::string_view(target->strings.data() + key[index].first, key[index].second); };
+      auto sort = [this, &count, &key_of]() {
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&key_of](uint32_t lhs, uint32_t rhs) { return key_of(lhs) < key_of(rhs); });
+      };
+      sort();
+
+      // Repeated key: the first entry takes the last value and the others are dropped, just like in json::value.
+      auto repeated = std::adjacent_find(order.begin(), order.end(), [&key_of](uint32_t lhs, uint32_t rhs) { return key_of(lhs) == key_of(rhs); });
+      if (repeated != order.end()) {
+        constexpr uint32_t dropped = UINT32_MAX; // Not a valid position of a node.
+        for (size_t run = 0; run < count;) {
+          size_t next = run + 1;
+          while (next < count && key_of(order[next]) == key_of(order[run])) {
+            children[current.first_child + order[run]] = child[order[next]];
+            children[current.first_child + order[next]] = dropped;
+            ++next;
+          }
+          run = next;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < count; ++i) {
+          if (child[i] != dropped) {
+            children[current.first_child + kept] = child[i];
+            keys[current.first_key + kept] = key[i];
+            ++kept;
+          }
+        }
+        count = kept;
+        sort();
+      }
+
+      auto& tables = target->tables;
+      detail::node& object = target->nodes[current.node];
+      object.offset = tables.size();
+      object.size = uint32_t(count);
+      tables.reserve(tables.size() + 4 * count);
+      for (size_t i = 0; i < count; ++i) {
+        tables.push_back(key[i].first);
+        tables.push_back(key[i].second);
+        tables.push_back(child[i]);
+      }
+      tables.insert(tables.end(), order.begin(), order.end());
+    }
+
+    void builder::write(const json::value& val) {
+      switch (val.type()) {
+      case value_type::null:    add(nullptr);     break;
+      case value_type::number:  add(val.number);  break;
+      case value_type::boolean: add(val.boolean); break;
+      case value_type::string:  add(val.string ? val.string->text() : std::string_view()); break;
+      case value_type::object:
+        open(value_type::object);
+        for (const auto& entry : val.object) {
+          key(entry.first.text());
+          write(entry.second);
+        }
+        close(value_type::object);
+        break;
+      case value_type::array:
+        open(value_type::array);
+        for (const auto& element : *val.array) {
+          write(element);
+        }
+        close(value_type::array);
+        break;
+      }
+    }
+
+    document builder::result() {
+      if (target->nodes.empty()) {
+        add(nullptr);
+      }
+      document frozen(std::shared_ptr<const detail::tape>(std::move(target)));
+      target = std::make_unique<detail::tape>();
+      start();
+      return frozen;
+    }
+  }
+
+  frozen::document freeze(const value& val) {
+    frozen::builder builder;
+    builder.write(val);
+    return builder.result();
+  }
+}
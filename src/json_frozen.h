@@ -0,0 +1,232 @@
+#ifndef _JSON_FROZEN_H_
+#define _JSON_FROZEN_H_
+
+// Immutable documents laid out flat for reading. Values are nodes of a single array (the tape) in document order,
+// each container node is followed by its whole subtree. Arrays find their elements through a table of node
+// positions, objects keep a table of entries in document order along with their positions sorted by key, so that a
+// key is found by binary search. Text of all strings and keys is stored back to back in one buffer. Nothing is ever
+// modified, so a document can be read from any number of threads at once.
+
+#include "json.h"
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace json {
+  namespace frozen {
+
+    class array_value;
+    class object_value;
+    class document;
+
+    namespace detail {
+      // Node of the tape. Payload of a string is the offset of its text, payload of a container is the offset of
+      // its table in `tables`.
+      struct node {
+        value_type type;
+        uint32_t   size; // Length of a string, number of elements or entries of a container.
+        union {
+          double   number;
+          bool     boolean;
+          uint64_t offset;
+        };
+      };
+
+      // Array table is the positions of its elements. Object table is its entries in document order as triples of
+      // key offset, key length and value position, followed by indices of the entries sorted by key.
+      struct tape {
+        std::vector<node>     nodes; // Root is the first one.
+        std::vector<uint32_t> tables;
+        std::string           strings;
+      };
+    }
+
+    // Read-only handle to a value of a frozen document, cheap to copy. Mirrors the reading part of json::value API.
+    // Handle is valid as long as the document it came from (or any copy of the document).
+    class value {
+    public:
+      // Type checking
+      bool       is_null()    const;
+      bool       is_string()  const;
+      bool       is_number()  const;
+      bool       is_boolean() const;
+      bool       is_object()  const;
+      bool       is_array()   const;
+      value_type get_type()   const;
+
+      // Retrieving values, strings are views into the document.
+      std::string_view as_string()  const;
+      double           as_number()  const;
+      bool             as_boolean() const;
+
+      // Object-related stuff
+      // Returns true if object contains a key.
+      bool has(std::string_view) const;
+      // Returns value stored in given key. There is nothing to insert into, so missing key throws json::json_error.
+      value operator[](std::string_view) const;
+
+      // Array-related stuff
+      // Returns value stored at given index, throws std::out_of_range if there is no such element.
+      value operator[](size_t) const;
+
+      // For object and arrays returns the number of entries.
+      size_t size() const;
+      // Returns true if object/array is empty
+      bool empty() const;
+
+      // Copy of the value with everything inside it as a regular tree, allocated from given resource.
+      json::value materialize(std::pmr::memory_resource* = std::pmr::get_default_resource()) const;
+      // Serialization - write a JSON representation of the value.
+      std::string serialize() const;
+
+      // Views of the value, valid as long as the document.
+      array_value  as_array()  const;
+      object_value as_object() const;
+
+      // Entries of objects follow the document order (which is also the insertion order of a frozen json::value).
+      using object_entry = std::pair<std::string_view, value>;
+      struct object_iterator {
+        using iterator_category = std::input_iterator_tag; // Entries are produced on the fly.
+        using value_type        = object_entry;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = object_entry;
+
+        object_iterator(const detail::tape* _source, const uint32_t* _entry) : source(_source), entry(_entry) {}
+        object_iterator& operator++() { entry += 3; return *this; }
+        object_iterator operator++(int) { object_iterator res = *this; ++(*this); return res; }
+        bool operator==(const object_iterator& other) const { return entry == other.entry; }
+        bool operator!=(const object_iterator& other) const { return entry != other.entry; }
+        reference operator*() const;
+      private:
+        const detail::tape* source;
+        const uint32_t* entry; // Key offset, key length and value position.
+      };
+
+      struct array_iterator {
+        using iterator_category = std::input_iterator_tag; // Elements are produced on the fly.
+        using value_type        = value;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = value;
+
+        array_iterator(const detail::tape* _source, const uint32_t* _position) : source(_source), position(_position) {}
+        array_iterator& operator++() { ++position; return *this; }
+        array_iterator operator++(int) { array_iterator res = *this; ++(*this); return res; }
+        bool operator==(const array_iterator& other) const { return position == other.position; }
+        bool operator!=(const array_iterator& other) const { return position != other.position; }
+        reference operator*() const { return value(source, &source->nodes[*position]); }
+      private:
+        const detail::tape* source;
+        const uint32_t* position; // Position of the element.
+      };
+
+    private:
+      friend class document;
+      friend class array_value;
+      friend class object_value;
+
+      value(const detail::tape* _source, const detail::node* _at) : source(_source), at(_at) {}
+
+      // Table of this container.
+      const uint32_t* table() const { return source->tables.data() + at->offset; }
+      // Position of the object entry with given key in the table, or size() if there is none.
+      size_t find(std::string_view) const;
+
+      const detail::tape* source;
+      const detail::node* at;
+    };
+
+    // Array-specific facade, the counterpart of json::const_array_value.
+    class array_value {
+      value wrapped_value;
+      explicit array_value(const value& _value) : wrapped_value(_value) {}
+      friend class value;
+    public:
+      // Docs for methods below are the same as for value methods.
+      value  operator[](size_t index) const { return wrapped_value[index]; }
+      size_t size() const  { return wrapped_value.at->size; }
+      bool   empty() const { return size() == 0; }
+      value::array_iterator begin() const;
+      value::array_iterator end() const;
+    };
+
+    // Object-specific facade, the counterpart of json::const_object_value.
+    class object_value {
+      value wrapped_value;
+      explicit object_value(const value& _value) : wrapped_value(_value) {}
+      friend class value;
+    public:
+      // Docs for methods below are the same as for value methods.
+      bool   has(std::string_view key) const { return wrapped_value.has(key); }
+      value  operator[](std::string_view key) const { return wrapped_value[key]; }
+      size_t size() const  { return wrapped_value.at->size; }
+      bool   empty() const { return size() == 0; }
+      value::object_iterator begin() const;
+      value::object_iterator end() const;
+    };
+
+    // Owner of a tape. Copies share it, so copying is cheap and values of one copy stay valid while any copy lives.
+    class document {
+      std::shared_ptr<const detail::tape> contents;
+      explicit document(std::shared_ptr<const detail::tape> _contents) : contents(std::move(_contents)) {}
+      friend class builder;
+    public:
+      // Document of a single null.
+      document();
+
+      value root() const;
+    };
+
+    // Writes a tape in document order from values, keys of object entries and bounds of containers, the same way
+    // parser hands them over to its sinks (see json_parser.cpp). If a key is repeated in an object, the later value
+    // replaces the earlier one, keeping the position of the earlier entry. Throws json::json_error if the document
+    // doesn't fit 32-bit offsets.
+    class builder {
+      struct frame {
+        uint32_t node;
+        size_t   first_child; // Children of the container are children[first_child...]
+        size_t   first_key;   // and keys of object entries are keys[first_key...].
+      };
+
+      std::unique_ptr<detail::tape> target;
+      std::vector<frame> frames;                            // Containers being written.
+      std::vector<uint32_t> children;                       // Positions of values written into them.
+      std::vector<std::pair<uint32_t, uint32_t>> keys;      // Keys of their entries as offset and length.
+      std::vector<uint32_t> order;                          // Scratch for sorting entries.
+
+      // Appends a node, which is the next child of the innermost container.
+      detail::node& emit(value_type, uint32_t size);
+      // Appends text to the strings and returns its offset.
+      uint32_t store(std::string_view);
+      void close_array(const frame&);
+      void close_object(const frame&);
+    public:
+      builder();
+
+      // Drops whatever was written so far.
+      void start();
+      void add(std::string_view);
+      void add(double);
+      void add(bool);
+      void add(std::nullptr_t);
+      void key(std::string_view);
+      void open(value_type);
+      void close(value_type);
+      // Writes given value with everything inside it.
+      void write(const json::value&);
+      // Finished document (a null one if nothing was written), builder starts over.
+      document result();
+    };
+  }
+
+  // Writes given value into a new frozen document.
+  frozen::document freeze(const value&);
+}
+
+#endif
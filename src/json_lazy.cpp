@@ -0,0 +1,333 @@
+#include "json_lazy.h"
+#include "json_parser.h"
+#include "json_sa.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+namespace json {
+  namespace lazy {
+
+    using simple::detail::cursor;
+    using simple::detail::is_whitespace;
+    using simple::detail::tokenizer_error;
+
+    const char* skip_whitespace(const char* pos, const char* end) {
+      while (pos != end && is_whitespace(*pos)) {
+        ++pos;
+      }
+      return pos;
+    }
+
+    [[noreturn]] void malformed(const char* pos, const char* end, const std::string& expected) {
+      throw json_error("Unable to read JSON: expected to see " + expected + ", but got " + (pos == end ? std::string("end of input") : "'" + std::string(1, *pos) + "'"));
+    }
+
+    inline bool is_delimiter(char c) {
+      return is_whitespace(c) || c == ',' || c == ']' || c == '}' || c == ':';
+    }
+
+    // Returns position right after the value starting at `pos` (see simple::detail::skip_value).
+    const char* skip_value(const char* pos, const char* end) {
+      if (pos == end) {
+        malformed(pos, end, "a value");
+      }
+      cursor cur{pos, end};
+      try {
+        simple::detail::skip_value(cur);
+      } catch (const tokenizer_error& error) {
+        throw json_error(error.what());
+      }
+      return cur.pos;
+    }
+
+    // Returns `pos` if there is a value (or an object key) to read there, throws if input ended.
+    const char* expect_entry(const char* pos, const char* end) {
+      if (pos == end) {
+        malformed(pos, end, "a value");
+      }
+      return pos;
+    }
+
+    // Moves past the separator that follows a container entry: returns start of the next entry or nullptr
+    // if container ends there.
+    const char* next_entry(const char* pos, const char* end, char closing) {
+      pos = skip_whitespace(pos, end);
+      if (pos != end && *pos == ',') {
+        return expect_entry(skip_whitespace(pos + 1, end), end);
+      }
+      if (pos != end && *pos == closing) {
+        return nullptr;
+      }
+      malformed(pos, end, std::string("',' or '") + closing + "'");
+    }
+
+    // Returns start of the first entry of a container starting at `pos` or nullptr if it is empty.
+    const char* first_entry(const char* pos, const char* end, char closing) {
+      pos = skip_whitespace(pos + 1, end);
+      if (pos != end && *pos == closing) {
+        return nullptr;
+      }
+      return expect_entry(pos, end);
+    }
+
+    // Reads object key starting at `pos`, leaves `pos` at the start of associated value.
+    std::string_view read_key(const char*& pos, const char* end, std::string& scratch) {
+      if (pos == end || *pos != '"') {
+        malformed(pos, end, "an object key");
+      }
+      cursor cur{pos + 1, end};
+      std::string_view key;
+      try {
+        key = simple::detail::read_string(cur, scratch);
+      } catch (const tokenizer_error& error) {
+        throw json_error(error.what());
+      }
+      pos = skip_whitespace(cur.pos, end);
+      if (pos == end || *pos != ':') {
+        malformed(pos, end, "':'");
+      }
+      pos = expect_entry(skip_whitespace(pos + 1, end), end);
+      return key;
+    }
+
+    void should_be(const value& val, value_type t) {
+      if (val.get_type() != t) {
+        throw json_error("Value of [type=" + utils::to_string(val.get_type()) + "] is treated as value of [type=" + utils::to_string(t) + "]");
+      }
+    }
+
+    // Docs in header.
+    value::value(std::string_view text) : begin(nullptr), end(text.data() + text.size()) {
+      begin = skip_whitespace(text.data(), end);
+      if (begin == end) {
+        throw json_error("Cannot read an empty string, top level value in JSON should be one of 'true', 'false', 'null', a string literal, an object or an array.");
+      }
+    }
+
+    bool value::is_null()    const { return get_type() == value_type::null; }
+    bool value::is_string()  const { return get_type() == value_type::string; }
+    bool value::is_number()  const { return get_type() == value_type::number; }
+    bool value::is_boolean() const { return get_type() == value_type::boolean; }
+    bool value::is_object()  const { return get_type() == value_type::object; }
+    bool value::is_array()   const { return get_type() == value_type::array; }
+
+    value_type value::get_type() const {
+      if (begin == end) {
+        malformed(begin, end, "a value");
+      }
+      switch (*begin) {
+      case 'n': return value_type::null;
+      case 't':
+      case 'f': return value_type::boolean;
+      case '"': return value_type::string;
+      case '{': return value_type::object;
+      case '[': return value_type::array;
+      default:
+        if (*begin == '-' || simple::detail::is_digit(*begin)) {
+          return value_type::number;
+        }
+        malformed(begin, end, "a value");
+      }
+    }
+
+    std::string value::as_string() const {
+      should_be(*this, value_type::string);
+      cursor cur{begin + 1, end};
+      std::string scratch;
+      try {
+        return std::string(simple::detail::read_string(cur, scratch));
+      } catch (const tokenizer_error& error) {
+        throw json_error(error.what());
+      }
+    }
+
+    double value::as_number() const {
+      should_be(*this, value_type::number);
+      cursor cur{begin, end};
+      double number;
+      try {
+        number = simple::detail::read_number(cur);
+      } catch (const tokenizer_error& error) {
+        throw json_error(error.what());
+      }
+      if (cur.pos != end && !is_delimiter(*cur.pos)) {
+        malformed(cur.pos, end, "end of number");
+      }
+      return number;
+    }
+
+    bool value::as_boolean() const {
+      should_be(*this, value_type::boolean);
+      const bool flag = *begin == 't';
+      cursor cur{begin, end};
+      try {
+        simple::detail::read_literal(cur, flag ? "true" : "false", flag ? 4 : 5);
+      } catch (const tokenizer_error& error) {
+        throw json_error(error.what());
+      }
+      return flag;
+    }
+
+    bool value::has(std::string_view key) const {
+      should_be(*this, value_type::object);
+      auto entries = as_object();
+      return std::any_of(entries.begin(), entries.end(), [key](const object_entry& entry) { return entry.first == key; });
+    }
+
+    // The whole object is walked, as the last of repeated keys wins (just like when parsing into json::value).
+    value value::operator[](std::string_view key) const {
+      should_be(*this, value_type::object);
+      std::optional<value> found;
+      for (const auto& entry : as_object()) {
+        if (entry.first == key) {
+          found = entry.second;
+        }
+      }
+      if (!found) {
+        throw json_error("Object has no [key=" + std::string(key) + "]");
+      }
+      return *found;
+    }
+
+    value value::operator[](size_t index) const {
+      should_be(*this, value_type::array);
+      size_t position = 0;
+      for (auto element : as_array()) {
+        if (position++ == index) {
+          return element;
+        }
+      }
+      throw std::out_of_range("Given [index=" + utils::to_string(index) + "] is out of bounds for the JSON array of [size=" + utils::to_string(position) + "]");
+    }
+
+    size_t value::size() const {
+      switch (get_type()) {
+      case value_type::array:
+        return as_array().size();
+      case value_type::object:
+        return as_object().size();
+      default:
+        throw json_error("Can only query size of object and array nodes, this node type is [type=" + utils::to_string(get_type()) + "]");
+      }
+    }
+
+    bool value::empty() const {
+      switch (get_type()) {
+      case value_type::array:
+        return as_array().empty();
+      case value_type::object:
+        return as_object().empty();
+      default:
+        throw json_error("Can only query emptiness of object and array nodes, this node type is [type=" + utils::to_string(get_type()) + "]");
+      }
+    }
+
+    std::string_view value::text() const {
+      return std::string_view(begin, skip_value(begin, end) - begin);
+    }
+
+    json::value value::materialize() const {
+      return parser::parse(text());
+    }
+
+    array_value value::as_array() const {
+      should_be(*this, value_type::array);
+      return array_value(*this);
+    }
+
+    object_value value::as_object() const {
+      should_be(*this, value_type::object);
+      return object_value(*this);
+    }
+
+    value::object_iterator::object_iterator(const char* pos, const char* _end)
+      : key_pos(nullptr), value_pos(nullptr), end(_end), raw_key(), decoded(false), scratch() {
+      if (pos) {
+        enter(pos);
+      }
+    }
+
+    void value::object_iterator::enter(const char* pos) {
+      key_pos = pos;
+      value_pos = pos;
+      raw_key = read_key(value_pos, end, scratch);
+      decoded = raw_key.data() == scratch.data();
+    }
+
+    value::object_iterator& value::object_iterator::operator++() {
+      const char* next = next_entry(skip_value(value_pos, end), end, '}');
+      if (next) {
+        enter(next);
+      } else {
+        key_pos = nullptr;
+      }
+      return *this;
+    }
+
+    value::object_iterator::reference value::object_iterator::operator*() const {
+      return object_entry(decoded ? std::string_view(scratch) : raw_key, value(value_pos, end));
+    }
+
+    value::array_iterator::array_iterator(const char* _pos, const char* _end) : pos(_pos), end(_end) {}
+
+    value::array_iterator& value::array_iterator::operator++() {
+      pos = next_entry(skip_value(pos, end), end, ']');
+      return *this;
+    }
+
+    size_t array_value::size() const {
+      return std::distance(begin(), end());
+    }
+
+    bool array_value::empty() const {
+      return begin() == end();
+    }
+
+    value::array_iterator array_value::begin() const {
+      return value::array_iterator(first_entry(wrapped_value.begin, wrapped_value.end, ']'), wrapped_value.end);
+    }
+
+    value::array_iterator array_value::end() const {
+      return value::array_iterator(nullptr, wrapped_value.end);
+    }
+
+    size_t object_value::size() const {
+      return std::distance(begin(), end());
+    }
+
+    bool object_value::empty() const {
+      return begin() == end();
+    }
+
+    value::object_iterator object_value::begin() const {
+      return value::object_iterator(first_entry(wrapped_value.begin, wrapped_value.end, '}'), wrapped_value.end);
+    }
+
+    value::object_iterator object_value::end() const {
+      return value::object_iterator(nullptr, wrapped_value.end);
+    }
+
+    document::document() : text(), file() {}
+    document::document(std::string _text) : text(std::make_unique<std::string>(std::move(_text))), file() {}
+    document::document(document&&) = default;
+    document& document::operator=(document&&) = default;
+    document::~document() = default;
+
+    document document::from_file(const std::string& path) {
+      document result;
+      try {
+        result.file = std::make_unique<utils::mapped_file>(path);
+      } catch (const std::runtime_error& error) {
+        throw json_error(error.what());
+      }
+      return result;
+    }
+
+    value document::root() const {
+      return file ? value(std::string_view(file->data(), file->size())) : value(*text);
+    }
+  }
+}
@@ -0,0 +1,183 @@
+#ifndef _JSON_LAZY_H_
+#define _JSON_LAZY_H_
+
+// On-demand access to JSON text. Values are located in the raw input buffer only when they are asked for and
+// nothing is materialized unless requested. Containers passed over on the way are skipped by bracket matching, so
+// their contents are not validated: malformed input is reported (as json::json_error) only when the malformed part
+// is actually accessed.
+
+#include "json.h"
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace json {
+  namespace utils {
+    class mapped_file;
+  }
+
+  namespace lazy {
+
+    class array_value;
+    class object_value;
+
+    // Read-only handle to a value within a buffer, cheap to copy. Mirrors the reading part of json::value API, but
+    // nothing is cached: every access walks the text again, so a container that is accessed over and over again is
+    // better materialized. Handle is valid as long as the buffer it points into.
+    class value {
+    public:
+      // Handle to the value that given text starts with (leading whitespace is skipped). Throws json::json_error if
+      // there is nothing but whitespace.
+      explicit value(std::string_view text);
+
+      // Type checking, only looks at the first character of the value.
+      bool       is_null()    const;
+      bool       is_string()  const;
+      bool       is_number()  const;
+      bool       is_boolean() const;
+      bool       is_object()  const;
+      bool       is_array()   const;
+      value_type get_type()   const;
+
+      // Retrieving values, strings are decoded into a fresh std::string.
+      std::string as_string()  const;
+      double      as_number()  const;
+      bool        as_boolean() const;
+
+      // Object-related stuff
+      // Returns true if object contains a key.
+      bool has(std::string_view) const;
+      // Returns value stored in given key. Unlike json::value there is nothing to insert into, so missing key
+      // throws json::json_error. If key is repeated, the last occurrence is returned, like json::value has it, so
+      // the whole object is walked.
+      value operator[](std::string_view) const;
+
+      // Array-related stuff
+      // Returns value stored at given index, throws std::out_of_range if there is no such element.
+      value operator[](size_t) const;
+
+      // For object and arrays returns the number of entries (walks the whole container).
+      size_t size() const;
+      // Returns true if object/array is empty
+      bool empty() const;
+
+      // Raw JSON text of the value (the whole subtree for containers).
+      std::string_view text() const;
+      // Parses the value with everything inside it into a DOM.
+      json::value materialize() const;
+
+      // Same as for json::value, views are valid as long as the buffer.
+      array_value  as_array()  const;
+      object_value as_object() const;
+
+      // Key is a view into the buffer or, if it has escapes, into the iterator that produced it.
+      using object_entry = std::pair<std::string_view, value>;
+      struct object_iterator {
+        using iterator_category = std::input_iterator_tag; // Entries are produced on the fly.
+        using value_type        = object_entry;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = object_entry;
+
+        object_iterator(const char* pos, const char* end);
+        object_iterator& operator++();
+        object_iterator operator++(int) {object_iterator res = *this; ++(*this); return res;}
+        bool operator==(const object_iterator& other) const { return key_pos == other.key_pos; }
+        bool operator!=(const object_iterator& other) const { return key_pos != other.key_pos; }
+        reference operator*() const;
+      private:
+        // Reads the entry whose key starts at `pos` (or ends iteration if it's '}').
+        void enter(const char* pos);
+
+        const char* key_pos;   // Opening quote of current key, nullptr once iteration is over.
+        const char* value_pos;
+        const char* end;
+        std::string_view raw_key;
+        bool decoded;          // Key had escapes and lives in `scratch`.
+        std::string scratch;
+      };
+
+      struct array_iterator {
+        using iterator_category = std::input_iterator_tag; // Elements are produced on the fly.
+        using value_type        = value;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = value;
+
+        array_iterator(const char* pos, const char* end);
+        array_iterator& operator++();
+        array_iterator operator++(int) {array_iterator res = *this; ++(*this); return res;}
+        bool operator==(const array_iterator& other) const { return pos == other.pos; }
+        bool operator!=(const array_iterator& other) const { return pos != other.pos; }
+        reference operator*() const { return value(pos, end); }
+      private:
+        const char* pos; // Start of current element, nullptr once iteration is over.
+        const char* end;
+      };
+
+    private:
+      friend class document;
+      friend class array_value;
+      friend class object_value;
+
+      // Value starting right at `begin` (no whitespace), `end` is the end of the whole buffer.
+      value(const char* _begin, const char* _end) : begin(_begin), end(_end) {}
+
+      const char* begin;
+      const char* end;
+    };
+
+    // Array-specific facade, the counterpart of json::array_value.
+    class array_value {
+      value wrapped_value;
+      explicit array_value(const value& _value) : wrapped_value(_value) {}
+      friend class value;
+    public:
+      // Docs for methods below are the same as for value methods.
+      value  operator[](size_t index) const { return wrapped_value[index]; }
+      size_t size() const;
+      bool   empty() const;
+      value::array_iterator begin() const;
+      value::array_iterator end() const;
+    };
+
+    // Object-specific facade, the counterpart of json::object_value.
+    class object_value {
+      value wrapped_value;
+      explicit object_value(const value& _value) : wrapped_value(_value) {}
+      friend class value;
+    public:
+      // Docs for methods below are the same as for value methods.
+      bool   has(std::string_view key) const { return wrapped_value.has(key); }
+      value  operator[](std::string_view key) const { return wrapped_value[key]; }
+      size_t size() const;
+      bool   empty() const;
+      value::object_iterator begin() const;
+      value::object_iterator end() const;
+    };
+
+    // Owner of the buffer lazy values point into: either a string or a memory-mapped file. Values stay valid
+    // while document lives (moving document doesn't invalidate them).
+    class document {
+      std::unique_ptr<std::string> text;
+      std::unique_ptr<utils::mapped_file> file;
+      document();
+    public:
+      // Takes ownership of given text.
+      explicit document(std::string text);
+      // Maps file at given path (see utils::mapped_file), throws json::json_error if it cannot be read.
+      static document from_file(const std::string& path);
+
+      document(document&&);
+      document& operator=(document&&);
+      ~document();
+
+      // Top level value. Throws json::json_error if document is empty.
+      value root() const;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _JSON_NUMBER_H_
+#define _JSON_NUMBER_H_
+
+// Conversion of JSON number text into double without going through locale-aware
+// standard library facilities.
+
+#include <cstdint>
+
+namespace json {
+  namespace numbers {
+
+    // Decimal number as read from JSON text: (-1)^negative * mantissa * 10^exponent.
+    // Mantissa keeps at most 19 significant digits (so that it always fits into 64 bits), if the text
+    // had more non-zero digits than that `truncated` is set and conversion has to look at the text itself.
+    struct decimal {
+      uint64_t mantissa;
+      int64_t  exponent;
+      bool     negative;
+      bool     truncated;
+    };
+
+    // Converts decimal into the nearest double (ties to even, as strtod does). [begin, end) is the
+    // original number text, it is only looked at when none of fast paths apply.
+    // Returns false if number doesn't fit into double (its magnitude rounds to infinity).
+    bool to_double(const decimal&, const char* begin, const char* end, double& result);
+  }
+}
+
+#endif
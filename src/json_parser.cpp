@@ -1,60 +1,95 @@
 #include "json.h"
 #include "json_parser.h"
 #include "json_sa.h"
+#include "json_simd.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <set>
 #include <stack>
 #include <sstream>
 #include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 namespace json {
   namespace parser {
 
     // The parsing process is implemented via stateful token_callback. It maintains current parsing context and
-    // attachment points (either an array or an object).
+    // hands tokens that fit the grammar over to a sink that builds something out of them. Sink is a template
+    // parameter and has to provide:
+    //   start()                            - parsing starts (again), whatever was left from the previous run is dropped;
+    //   add(T), T is one of std::string_view, double, bool and std::nullptr_t
+    //                                      - next value: top level one, an array element or value of an object entry;
+    //   key(std::string_view)              - key of the next object entry;
+    //   open(value_type), close(value_type) - bounds of arrays and objects.
+    // Views passed to sink are only valid for the duration of the call.
 
     // Value representing next expected token - none is not really needed
     enum class next_token : int { none, value, comma, colon, key };
 
-    class builder_callback : public simple::token_callback {
+    // Class is final, so that templated tokenizer can call into it without virtual dispatch.
+    template<typename Sink>
+    class grammar_callback final : public simple::token_callback {
+      // Container being read, `empty` until its first value is read.
+      struct container {
+        value_type type;
+        bool empty;
+      };
+
       bool failed;
-      value root;                             // By default we will have null value.
-      std::stack<next_token> context;         // Stack of expected tokens - embodiment of the parsing state machine.
-      std::stack<value*> objects_being_built; // Stack of non-owning pointers, for in-place building. The state of parse fully determined by context and object_being_built.
-      std::stack<std::string> keys;
+      std::vector<next_token> context;  // Stack of expected tokens - embodiment of the parsing state machine.
+      std::vector<container> containers; // The state of parse fully determined by context and containers.
 
     public:
-      builder_callback() : failed(false), root(), context(), objects_being_built(), keys() {}
+      Sink sink;
+
+      // Arguments are passed on to sink.
+      template<typename... Args>
+      explicit grammar_callback(Args&&... args) : failed(false), context(), containers(), sink(std::forward<Args>(args)...) {}
 
-      // At the start of parsing process we expect to see a single top level value.
+      // At the start of parsing process we expect to see a single top level value. Stacks are cleared rather than
+      // recreated, so that callback can be reused without allocating them again.
       void json_start() override {
-        context.push(next_token::value);
+        failed = false;
+        context.clear();
+        containers.clear();
+        sink.start();
+        context.push_back(next_token::value);
       }
 
       // Usage scenario assumes this callback won't be reused, so we do not cleanup anything.
       void json_end() override {}
 
       // The string we receive could be either key or a value.
-      void json_string(const std::string& str) override {
+      void json_string_view(std::string_view str) override {
         if (expects(next_token::value)) {
-          attach(value(str));
-          context.pop();
+          sink.add(str);
+          context.pop_back();
           value_read();
         } else if (expects(next_token::key)) {
-          context.pop();
-          context.push(next_token::colon);
-          keys.push(str);
+          context.back() = next_token::colon;
+          sink.key(str);
         } else {
-          fail("[string:" + str + "]");
+          fail("[string:" + std::string(str) + "]");
         }
       }
 
       // Number is always a value
       void json_number(double num) override {
         if (expects(next_token::value)) {
-          attach(value(num));
-          context.pop();
+          sink.add(num);
+          context.pop_back();
           value_read();
         } else {
           fail("[double:" + utils::to_string(num) + "]");
@@ -64,8 +99,8 @@ namespace json {
       // Boolean is always a value.
       void json_boolean(bool flag) override {
         if (expects(next_token::value)) {
-          attach(value(flag));
-          context.pop();
+          sink.add(flag);
+          context.pop_back();
           value_read();
         } else {
           fail("[boolean:" + utils::to_string(flag ? "true" : "false") + "]");
@@ -75,8 +110,8 @@ namespace json {
       // Null is always a value.
       void json_null() override {
         if (expects(next_token::value)) {
-          attach(value());
-          context.pop();
+          sink.add(nullptr);
+          context.pop_back();
           value_read();
         } else {
           fail("[null]");
@@ -86,11 +121,10 @@ namespace json {
       // Comma can separate entries in array or object, so we check if we are in_array or in_object
       void json_comma() override {
         if (expects(next_token::comma)) {
-          context.pop();
           if (in_array()) {
-            context.push(next_token::value);
+            context.back() = next_token::value;
           } else if (in_object()) {
-            context.push(next_token::key);
+            context.back() = next_token::key;
           } else {
             assert(!"Encountered a comma, but not building an object or an array.");
           }
@@ -103,8 +137,7 @@ namespace json {
       void json_colon() override {
         if (expects(next_token::colon)) {
           assert(in_object());
-          context.pop();
-          context.push(next_token::value);
+          context.back() = next_token::value;
         } else {
           fail("[:(colon)]");
         }
@@ -113,8 +146,9 @@ namespace json {
       // Array is always a value.
       void json_array_starts() override {
         if (expects(next_token::value)) {
-          objects_being_built.push(attach(value_type::array));
-          context.push(next_token::value);
+          containers.push_back(container{value_type::array, true});
+          sink.open(value_type::array);
+          context.push_back(next_token::value);
         } else {
           fail("[(array)]");
         }
@@ -131,11 +165,12 @@ namespace json {
           return; // Not strictly necessary here as fail will throw.
         }
 
-        if ((expects(next_token::value) && empty_attach_point()) || expects(next_token::comma)) {
-          context.pop(); // Pop the value (expected first value of the array) or comma
+        if ((expects(next_token::value) && containers.back().empty) || expects(next_token::comma)) {
+          context.pop_back(); // Pop the value (expected first value of the array) or comma
           assert(expects(next_token::value));
-          context.pop(); // Pop the value (the value for the array itself).
-          objects_being_built.pop();
+          containers.pop_back();
+          sink.close(value_type::array);
+          context.pop_back(); // Pop the value (the value for the array itself).
           value_read();
         } else {
           fail("[(array_end)]");
@@ -145,8 +180,9 @@ namespace json {
       // Object is always a value.
       void json_object_starts() override {
         if (expects(next_token::value)) {
-          objects_being_built.push(attach(value_type::object));
-          context.push(next_token::key);
+          containers.push_back(container{value_type::object, true});
+          sink.open(value_type::object);
+          context.push_back(next_token::key);
         } else {
           fail("[(object)]");
         }
@@ -163,11 +199,12 @@ namespace json {
           return; // Not strictly necessary here as fail will throw.
         }
 
-        if ((expects(next_token::key) && empty_attach_point()) || expects(next_token::comma)) {
-          context.pop(); // Pop the expected key/comma
+        if ((expects(next_token::key) && containers.back().empty) || expects(next_token::comma)) {
+          context.pop_back(); // Pop the expected key/comma
           assert(expects(next_token::value));
-          context.pop(); // Pop the value
-          objects_being_built.pop();
+          containers.pop_back();
+          sink.close(value_type::object);
+          context.pop_back(); // Pop the value
           value_read();
         } else {
           fail("[(object_end)]");
@@ -184,12 +221,12 @@ namespace json {
       virtual bool need_more_json() override { return !failed && !expects(next_token::none); }
 
       // If for some reason someone attempts to query restul when we haven't finished parsing
-      // we throw out the error.
-      value result() {
+      // we throw out the error. Result is moved out, so it can be taken only once.
+      auto result() {
         if (!need_more_json()) {
-          return root; 
+          return sink.result();
         }
-        throw json::json_error("Parsing process is not finished: [built=" + utils::to_string(objects_being_built.size()) + "][need_more=" + utils::to_string(need_more_json() ? "true" : "false") + "]");
+        throw json::json_error("Parsing process is not finished: [built=" + utils::to_string(containers.size()) + "][need_more=" + utils::to_string(need_more_json() ? "true" : "false") + "]");
       }
 
     private:
@@ -200,70 +237,29 @@ namespace json {
           return val == next_token::none;
         }
 
-        return context.top() == val;
+        return context.back() == val;
       }
 
-      // We are in array if top level object_being_built is of type array.
+      // We are in array if innermost container being built is an array.
       inline bool in_array() const {
         return in(value_type::array);
       }
 
-      // We are in object if top level object_being_built is of type object.
+      // We are in object if innermost container being built is an object.
       inline bool in_object() const {
         return in(value_type::object);
       }
 
       // Common code for in_object/in_array
       bool in(value_type t) const {
-        if (objects_being_built.empty()) {
-          return false;
-        }
-        auto current_object = objects_being_built.top();
-        return current_object && current_object->get_type() == t;
-      }
-
-      // We have empty attachment point if its either an array or an object and has empty() == true
-      bool empty_attach_point() const {
-        assert(!objects_being_built.empty());
-        auto current_object = objects_being_built.top();
-        auto obj_type = current_object->get_type();
-        bool is_container = (obj_type == value_type::array) || (obj_type == value_type::object);
-        assert(is_container);
-        return current_object->empty();
-      }
-
-      // Attaches freshly parsed value to one currently being built. If no objects
-      // are being built - replace root.
-      value* attach(value&& value) {
-        assert(expects(next_token::value));
-        if (objects_being_built.empty()) {
-          root = std::move(value);
-          return &root;
-        }
-
-        auto& current_object = objects_being_built.top();
-        switch(current_object->get_type()) {
-        case value_type::object: {
-          const std::string& key = keys.top();
-          auto* value_p = &((*current_object)[key] = std::move(value)); // Store pointer as per recommendation.
-          keys.pop();
-          return value_p;
-        }
-        case value_type::array: {
-          size_t last_index = (*current_object).push(std::move(value));
-          return &((*current_object)[last_index]);
-        }
-        default:
-          // Not sure if this is good style, but no other way to print custom error message from stock assert.
-          assert(false && ("Cannot attach to a [type=" + utils::to_string(current_object->get_type()) + "] value").c_str()); 
-          return nullptr; // To avoid compiler warnings
-        }
+        return !containers.empty() && containers.back().type == t;
       }
 
       // Convenience function to push comma if need be.
       void value_read() {
-        if (in_array() || in_object()) {
-          context.push(next_token::comma);
+        if (!containers.empty()) {
+          containers.back().empty = false;
+          context.push_back(next_token::comma);
         }
       }
 
@@ -297,16 +293,1253 @@ namespace json {
       }
     };
 
-    json::value parse(const std::string& source) {
-      builder_callback callback; 
-      run_tokenizer(source, callback);
+    // Sink that builds a new tree. Containers are materialized only when they end: until then their children are
+    // collected on a shared stack, so each container is allocated once with its final size. Stacks keep their
+    // capacity between runs.
+    class tree_builder {
+      std::pmr::memory_resource* resource; // Everything built is allocated from it.
+      document* interned;                  // Document whose keys are shared, if building in its arena.
+      value root;                          // By default we will have null value.
+      std::vector<size_t> frames;          // Containers being built, their children are children[frames[i]...].
+      std::vector<value> children;         // Finished children of containers being built.
+      std::string key_text;                // Keys of object entries being built (the same number of topmost ones),
+      std::vector<std::pair<size_t, size_t>> keys; // stored back to back as [offset, length) of key_text.
+
+    public:
+      explicit tree_builder(std::pmr::memory_resource* _resource = std::pmr::get_default_resource())
+        : resource(_resource), interned(nullptr), root(value_type::null, resource), frames(), children(), key_text(), keys() {}
+      explicit tree_builder(document& target)
+        : resource(target.resource()), interned(&target), root(value_type::null, resource), frames(), children(), key_text(), keys() {}
+
+      void start() {
+        root = nullptr;
+        frames.clear();
+        children.clear();
+        key_text.clear();
+        keys.clear();
+      }
+
+      // View is copied exactly once - into the value or the key that is being built. Short strings of a document
+      // are shared.
+      void add(std::string_view str) {
+        if (interned && !str.empty() && str.size() <= document::short_string_size) {
+          value shared(value_type::string, resource);
+          shared.string = interned->intern_string(str);
+          attach(std::move(shared));
+        } else {
+          attach(value(str, resource));
+        }
+      }
+      void add(double num)           { attach(value(num)); }
+      void add(bool flag)            { attach(value(flag)); }
+      void add(std::nullptr_t)       { attach(value()); }
+
+      void key(std::string_view str) {
+        keys.emplace_back(key_text.size(), str.size());
+        key_text.append(str);
+      }
+
+      void open(value_type) {
+        frames.push_back(children.size());
+      }
+
+      void close(value_type type) {
+        attach(type == value_type::array ? close_array() : close_object());
+      }
+
+      value result() {
+        return std::move(root);
+      }
+
+    private:
+      // Attaches freshly parsed value to the container currently being built. If no containers
+      // are being built - replace root.
+      void attach(value&& value) {
+        if (frames.empty()) {
+          root = std::move(value);
+        } else {
+          children.push_back(std::move(value));
+        }
+      }
+
+      // Moves children of the innermost container (which is an array) into a new array of exact size.
+      value close_array() {
+        const size_t first = frames.back();
+        frames.pop_back();
+
+        value array(value_type::array, resource);
+        array.reserve(children.size() - first);
+        for (size_t i = first; i < children.size(); ++i) {
+          array.push(std::move(children[i]));
+        }
+        children.erase(children.begin() + first, children.end());
+        return array;
+      }
+
+      // Same as above for object, each child is paired with one of the topmost keys. Later duplicate key
+      // replaces the earlier one. Keys are interned when building a document.
+      value close_object() {
+        const size_t first = frames.back();
+        const size_t count = children.size() - first;
+        const size_t first_key = keys.size() - count;
+        frames.pop_back();
+
+        value object(value_type::object, resource);
+        object.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+          const auto& key = keys[first_key + i];
+          const auto text = std::string_view(key_text).substr(key.first, key.second);
+          if (!interned) {
+            object.assign(text, std::move(children[first + i]));
+            continue;
+          }
+          const detail::key_block* shared = interned->intern_key(text);
+          const size_t position = object.object.find(shared);
+          if (position == detail::object_map::npos) {
+            object.object.append(shared, value(std::move(children[first + i]), resource), resource);
+          } else {
+            object.object[position].second = std::move(children[first + i]);
+          }
+        }
+        children.erase(children.begin() + first, children.end());
+        if (count != 0) {
+          key_text.resize(keys[first_key].first);
+        }
+        keys.erase(keys.begin() + first_key, keys.end());
+        return object;
+      }
+    };
+
+    using builder_callback = grammar_callback<tree_builder>;
+
+    // Sink that writes parsed values over an existing tree: each value replaces the one at the same place (same key
+    // or index) of the target, so containers, entries and strings that are already there keep their storage. Entries
+    // are rearranged to follow the input order, so that keys of similarly shaped objects are found right where they
+    // are expected. Array elements and object entries that are not in the input are removed once their container ends.
+    class tree_updater {
+      struct frame {
+        value* container;
+        size_t count; // Elements or distinct entries written so far, they are the first ones of the container.
+      };
+
+      value* root;
+      value* next;               // Destination of the next value of an object entry.
+      std::vector<frame> frames; // Containers being written.
+
+    public:
+      tree_updater() : root(nullptr), next(nullptr), frames() {}
+
+      // Sets value to be written over by the next run.
+      void attach(value& target) { root = &target; }
+
+      void start() {
+        frames.clear();
+      }
+
+      void add(std::string_view str) { destination() = str; }
+      void add(double num)           { destination() = num; }
+      void add(bool flag)            { destination() = flag; }
+      void add(std::nullptr_t)       { destination() = nullptr; }
+
+      void key(std::string_view str) {
+        frame& current = frames.back();
+        auto& object = current.container->object;
+        size_t position = current.count < object.size() && object[current.count].first.text() == str ? current.count : object.find(str);
+        if (position == detail::object_map::npos) {
+          position = object.append(str, value(value_type::null, current.container->resource()), current.container->resource());
+        }
+        if (position >= current.count) { // Repeated key is written over again, otherwise entry joins written ones.
+          if (position != current.count) {
+            object.swap(position, current.count);
+          }
+          position = current.count++;
+        }
+        next = &object[position].second;
+      }
+
+      void open(value_type type) {
+        value& container = destination();
+        if (container.type() != type) {
+          container = value(type, container.resource());
+        } else {
+          container.unshare(); // Its children are written over in place.
+        }
+        frames.push_back(frame{&container, 0});
+      }
+
+      void close(value_type type) {
+        const frame current = frames.back();
+        frames.pop_back();
+        if (type == value_type::array) {
+          auto& array = *current.container->array;
+          array.erase(array.begin() + current.count, array.end());
+        } else {
+          current.container->object.truncate(current.count, current.container->resource());
+        }
+      }
+
+    private:
+      // Value that next parsed value goes to.
+      value& destination() {
+        if (frames.empty()) {
+          return *root;
+        }
+        frame& current = frames.back();
+        value& container = *current.container;
+        if (container.type() == value_type::object) {
+          return *next;
+        }
+        if (current.count == container.array->size()) {
+          container.array->push_back(value(value_type::null, container.resource()));
+        }
+        return (*container.array)[current.count++];
+      }
+    };
+    // Decodes JSON Pointer escapes of a path segment ("~1" is '/', "~0" is '~').
+    std::string unescape_segment(const std::string& path, size_t begin, size_t end) {
+      std::string segment;
+      for (size_t i = begin; i < end; ++i) {
+        if (path[i] != '~') {
+          segment.push_back(path[i]);
+        } else if (i + 1 < end && (path[i + 1] == '0' || path[i + 1] == '1')) {
+          segment.push_back(path[++i] == '0' ? '~' : '/');
+        } else {
+          throw json::json_error("Malformed projection [path=" + path + "]: '~' should be followed by '0' or '1'.");
+        }
+      }
+      return segment;
+    }
+
+    projection::projection(std::initializer_list<std::string_view> paths) : projection(std::vector<std::string>(paths.begin(), paths.end())) {}
+
+    // Paths are first put into a trie where "*" is just another edge, which is then turned into a deterministic
+    // automaton by subset construction: a node of the automaton stands for the set of trie nodes a key may lead to.
+    projection::projection(const std::vector<std::string>& paths) : nodes() {
+      struct trie_node {
+        std::map<std::string, size_t> children;
+        size_t wildcard;
+        bool terminal;
+      };
+      std::vector<trie_node> trie{trie_node{{}, none, false}};
+      for (const auto& path : paths) {
+        if (!path.empty() && path[0] != '/') {
+          throw json::json_error("Malformed projection [path=" + path + "]: JSON Pointer should start with '/'.");
+        }
+        size_t current = 0;
+        for (size_t begin = 0; begin < path.size(); ) {
+          const size_t end = std::min(path.find('/', begin + 1), path.size());
+          const std::string segment = unescape_segment(path, begin + 1, end);
+          const bool wildcard = segment == "*";
+          auto child = trie[current].children.find(segment);
+          size_t next = wildcard ? trie[current].wildcard : (child != trie[current].children.end() ? child->second : none);
+          if (next == none) {
+            next = trie.size();
+            trie.push_back(trie_node{{}, none, false});
+            if (wildcard) {
+              trie[current].wildcard = next;
+            } else {
+              trie[current].children.emplace(segment, next);
+            }
+          }
+          current = next;
+          begin = end;
+        }
+        trie[current].terminal = true;
+      }
+
+      std::map<std::vector<size_t>, size_t> ids;
+      std::vector<std::vector<size_t>> sets;
+      auto node_of = [this, &ids, &sets](std::vector<size_t> set) {
+        if (set.empty()) {
+          return none;
+        }
+        std::sort(set.begin(), set.end());
+        set.erase(std::unique(set.begin(), set.end()), set.end());
+        auto found = ids.find(set);
+        if (found != ids.end()) {
+          return found->second;
+        }
+        ids.emplace(set, nodes.size());
+        sets.push_back(std::move(set));
+        nodes.push_back(node{{}, none, false});
+        return nodes.size() - 1;
+      };
+
+      node_of({0});
+      for (size_t i = 0; i < nodes.size(); ++i) {
+        const std::vector<size_t> set = sets[i];
+        if (std::any_of(set.begin(), set.end(), [&trie](size_t n) { return trie[n].terminal; })) {
+          nodes[i].whole = true;
+          continue;
+        }
+
+        std::vector<size_t> others;
+        std::set<std::string> keys;
+        for (size_t n : set) {
+          if (trie[n].wildcard != none) {
+            others.push_back(trie[n].wildcard);
+          }
+          for (const auto& child : trie[n].children) {
+            keys.insert(child.first);
+          }
+        }
+        for (const auto& key : keys) {
+          std::vector<size_t> targets = others;
+          for (size_t n : set) {
+            auto child = trie[n].children.find(key);
+            if (child != trie[n].children.end()) {
+              targets.push_back(child->second);
+            }
+          }
+          const size_t target = node_of(std::move(targets));
+          nodes[i].children.emplace(key, target);
+        }
+        const size_t target = node_of(std::move(others));
+        nodes[i].others = target;
+      }
+    }
+
+    // Passes tokens through projection: only tokens of selected values (and of containers on the way to them) reach
+    // the builder, values that aren't selected are skipped by the tokenizer. Separators of containers on the way are
+    // not forwarded as is, but synthesized between entries that are kept. Since builder doesn't see everything,
+    // structure of the containers on the way is validated here.
+    class projection_callback final : public simple::token_callback {
+      // Container on the way to selected values.
+      struct frame {
+        size_t node;  // Projection node of the container.
+        bool array;
+        size_t index; // Index of the current array element.
+        size_t kept;  // Entries passed to builder so far.
+      };
+      enum class expecting { value, value_or_end, key, key_or_end, colon, comma_or_end, done };
+
+      builder_callback& builder;
+      const projection& paths;
+      std::vector<frame> frames;
+      expecting next;
+      size_t target;      // Projection node of the next value, projection::none if it is dropped.
+      std::string key;    // Key of the next object entry, forwarded together with its value.
+      size_t whole_depth; // Non-zero inside a container that is kept whole, its tokens are forwarded as is.
+
+    public:
+      projection_callback(builder_callback& _builder, const projection& _paths)
+        : builder(_builder), paths(_paths), frames(), next(expecting::value), target(0), key(), whole_depth(0) {}
+
+      void json_start() override { builder.json_start(); }
+      void json_end() override { builder.json_end(); }
+
+      bool skip_next_value() override {
+        return whole_depth == 0 && target == projection::none && (next == expecting::value || next == expecting::value_or_end);
+      }
+
+      void json_value_skipped() override { value_done(); }
+
+      void json_string_view(std::string_view str) override {
+        if (whole_depth == 0 && (next == expecting::key || next == expecting::key_or_end)) {
+          const auto& node = paths.nodes[frames.back().node];
+          auto child = node.children.find(str);
+          target = child != node.children.end() ? child->second : node.others;
+          if (target != projection::none) {
+            key.assign(str);
+          }
+          next = expecting::colon;
+          return;
+        }
+        scalar([this, str]() { builder.json_string_view(str); }, "[string:" + std::string(str) + "]");
+      }
+
+      void json_number(double num) override {
+        scalar([this, num]() { builder.json_number(num); }, "[double:" + utils::to_string(num) + "]");
+      }
+
+      void json_boolean(bool flag) override {
+        scalar([this, flag]() { builder.json_boolean(flag); }, "[boolean]");
+      }
+
+      void json_null() override {
+        scalar([this]() { builder.json_null(); }, "[null]");
+      }
+
+      void json_colon() override {
+        if (whole_depth != 0) {
+          builder.json_colon();
+        } else if (next == expecting::colon) {
+          next = expecting::value;
+        } else {
+          fail("[:(colon)]");
+        }
+      }
+
+      void json_comma() override {
+        if (whole_depth != 0) {
+          builder.json_comma();
+        } else if (next == expecting::comma_or_end) {
+          auto& current = frames.back();
+          if (current.array) {
+            ++current.index;
+            next = expecting::value;
+            target = element_target(current);
+          } else {
+            next = expecting::key;
+          }
+        } else {
+          fail("[,(comma)]");
+        }
+      }
+
+      void json_array_starts() override { container_starts(true); }
+      void json_array_ends() override { container_ends(true); }
+      void json_object_starts() override { container_starts(false); }
+      void json_object_ends() override { container_ends(false); }
+
+      void json_error(const std::string& error) override { builder.json_error(error); }
+
+      bool need_more_json() override { return next != expecting::done; }
+
+    private:
+      // Scalar is forwarded only if it is selected as a whole, scalar top level value that isn't becomes null.
+      template<typename Forward>
+      void scalar(Forward forward, const std::string& description) {
+        if (whole_depth != 0) {
+          forward();
+          return;
+        }
+        expect_value(description);
+        if (paths.nodes[target].whole) {
+          entry_prefix();
+          forward();
+        } else if (frames.empty()) {
+          builder.json_null();
+        }
+        value_done();
+      }
+
+      void container_starts(bool array) {
+        if (whole_depth != 0) {
+          ++whole_depth;
+          array ? builder.json_array_starts() : builder.json_object_starts();
+          return;
+        }
+        expect_value(array ? "[(array)]" : "[(object)]");
+        entry_prefix();
+        array ? builder.json_array_starts() : builder.json_object_starts();
+        if (paths.nodes[target].whole) {
+          whole_depth = 1;
+          return;
+        }
+        frames.push_back(frame{target, array, 0, 0});
+        if (array) {
+          next = expecting::value_or_end;
+          target = element_target(frames.back());
+        } else {
+          next = expecting::key_or_end;
+        }
+      }
+
+      void container_ends(bool array) {
+        if (whole_depth != 0) {
+          array ? builder.json_array_ends() : builder.json_object_ends();
+          if (--whole_depth == 0) {
+            value_done();
+          }
+          return;
+        }
+        const expecting empty = array ? expecting::value_or_end : expecting::key_or_end;
+        if (frames.empty() || frames.back().array != array || (next != expecting::comma_or_end && next != empty)) {
+          fail(array ? "[(array_end)]" : "[(object_end)]");
+        }
+        frames.pop_back();
+        array ? builder.json_array_ends() : builder.json_object_ends();
+        value_done();
+      }
+
+      void expect_value(const std::string& description) {
+        if (next != expecting::value && next != expecting::value_or_end) {
+          fail(description);
+        }
+        assert(target != projection::none); // Such values are skipped.
+      }
+
+      // Forwards separator and key (for objects) that precede value being kept.
+      void entry_prefix() {
+        if (frames.empty()) {
+          return;
+        }
+        auto& current = frames.back();
+        if (current.kept++ != 0) {
+          builder.json_comma();
+        }
+        if (!current.array) {
+          builder.json_string_view(key);
+          builder.json_colon();
+        }
+      }
+
+      void value_done() {
+        next = frames.empty() ? expecting::done : expecting::comma_or_end;
+      }
+
+      // Array elements are matched by their decimal index.
+      size_t element_target(const frame& array) const {
+        const auto& node = paths.nodes[array.node];
+        if (node.children.empty()) {
+          return node.others;
+        }
+        char digits[24];
+        const auto printed = std::to_chars(digits, digits + sizeof(digits), array.index);
+        auto child = node.children.find(std::string_view(digits, printed.ptr - digits));
+        return child != node.children.end() ? child->second : node.others;
+      }
+
+      [[noreturn]] void fail(const std::string& reason) {
+        builder.json_error("Unable to parse JSON: unexpected " + reason);
+        throw json::json_error("Unable to parse JSON: unexpected " + reason); // Builder has thrown already.
+      }
+    };
+
+    // Feeds a run of consecutive top level array elements into builder as if they formed a standalone array:
+    // builder is made to believe it has seen '[' before the first element, and tokenization stops at the separator
+    // following the last one (',' or the closing ']' of the whole document).
+    class element_run_callback final : public simple::token_callback {
+      builder_callback& builder;
+      size_t remaining;  // Elements of the run that are not completed yet.
+      size_t depth;      // Nesting depth relative to the top level array.
+      bool element_seen; // Whether current element has produced any tokens.
+
+    public:
+      element_run_callback(builder_callback& _builder, size_t elements) : builder(_builder), remaining(elements), depth(0), element_seen(false) {}
+
+      void json_start() override {
+        builder.json_start();
+        builder.json_array_starts();
+      }
+
+      void json_end() override {
+        builder.json_array_ends();
+        builder.json_end();
+      }
+
+      void json_string_view(std::string_view str) override { element_seen = true; builder.json_string_view(str); }
+      void json_number(double num) override              { element_seen = true; builder.json_number(num); }
+      void json_boolean(bool flag) override              { element_seen = true; builder.json_boolean(flag); }
+      void json_null() override                          { element_seen = true; builder.json_null(); }
+      void json_colon() override                         { builder.json_colon(); }
+
+      void json_comma() override {
+        if (depth == 0 && element_ends()) {
+          return;
+        }
+        builder.json_comma();
+      }
+
+      void json_array_starts() override {
+        element_seen = true;
+        ++depth;
+        builder.json_array_starts();
+      }
+
+      // At depth 0 this is the end of the whole document, so it must follow the last element of the run.
+      void json_array_ends() override {
+        if (depth == 0) {
+          if (!element_ends()) {
+            builder.json_error("Top level array ended before all of its elements were read.");
+          }
+          return;
+        }
+        --depth;
+        builder.json_array_ends();
+      }
+
+      void json_object_starts() override {
+        element_seen = true;
+        ++depth;
+        builder.json_object_starts();
+      }
+
+      // Object ending at depth 0 is forwarded as is, builder rejects it since it is building an array there.
+      void json_object_ends() override {
+        if (depth != 0) {
+          --depth;
+        }
+        builder.json_object_ends();
+      }
+
+      void json_error(const std::string& error) override { builder.json_error(error); }
+
+      bool need_more_json() override { return remaining != 0 && builder.need_more_json(); }
+
+    private:
+      // Called on separator following an element, returns true if that was the last element of the run.
+      bool element_ends() {
+        if (!element_seen) {
+          builder.json_error("Unable to parse JSON: expected to see an array element, but got a separator.");
+        }
+        element_seen = false;
+        return --remaining == 0;
+      }
+    };
+
+    // Boundaries of top level array elements: element i spans [starts[i], separators[i]).
+    struct array_layout {
+      std::vector<uint32_t> starts;
+      std::vector<uint32_t> separators;
+    };
+
+    // Locates top level array elements with the help of structural index. Returns false if document is not
+    // an array or its end is not found (sequential parse will report the error then). Index is built in windows,
+    // just like token_index does, so only the layout itself takes memory proportional to the document.
+    bool find_elements(const char* data, size_t length, array_layout& layout) {
+      if (length > UINT32_MAX) {
+        return false;
+      }
+
+      size_t depth = 0; // Zero until the opening bracket is seen, the search is over once it drops back to zero.
+      bool element_starts = true;
+      bool found = false;
+      // Returns false once the search is over, `found` tells how it went.
+      auto visit = [&](uint32_t position) {
+        const char c = data[position];
+        if (depth == 0) {
+          depth = 1;
+          return c == '[';
+        }
+        if (element_starts) {
+          if (c == ']' && layout.starts.empty()) {
+            found = true; // Empty array.
+            return false;
+          }
+          layout.starts.push_back(position); // Malformed element (like in "[,1]") is reported when it gets parsed.
+          element_starts = false;
+        }
+        switch (c) {
+        case '[':
+        case '{':
+          ++depth;
+          break;
+        case ']':
+        case '}':
+          if (--depth == 0) {
+            layout.separators.push_back(position);
+            found = true;
+            return false;
+          }
+          break;
+        case ',':
+          if (depth == 1) {
+            layout.separators.push_back(position);
+            element_starts = true;
+          }
+          break;
+        }
+        return true;
+      };
+
+      // A window may end in the middle of a string, so unless it is the last one, its last position (a token start,
+      // which is never inside a string) begins the next window. A window that has no other positions is grown.
+      constexpr size_t window_bytes = simple::detail::token_index::window_bytes;
+      std::vector<uint32_t> positions;
+      size_t from = 0;
+      size_t window = window_bytes;
+      while (from != length) {
+        const size_t size = std::min(window, length - from);
+        const bool last = from + size == length;
+        simd::build_structural_index(data + from, size, positions);
+        if (!last && positions.size() == 1 && positions[0] == 0) {
+          window *= 2;
+          continue;
+        }
+        const size_t count = last || positions.empty() ? positions.size() : positions.size() - 1;
+        for (size_t i = 0; i < count; ++i) {
+          if (!visit(uint32_t(from + positions[i]))) {
+            return found;
+          }
+        }
+        from = count == positions.size() ? from + size : from + positions.back();
+        window = window_bytes;
+      }
+      return false;
+    }
+
+    // Parses `count` elements of the top level array starting at `first` into an array value. Only the part of
+    // the buffer up to the separator after the last element gets indexed, tokens themselves may look further
+    // (a number needs to see the character following it).
+    json::value parse_element_run(const char* first, const char* last_separator, const char* end, size_t count) {
+      builder_callback builder;
+      element_run_callback callback(builder, count);
+      simple::detail::cursor cur{first, end};
+      simple::detail::token_index index(first, last_separator - first + 1);
+      std::string scratch;
+      callback.json_start();
+      if (simple::detail::tokenize(cur, index, scratch, nullptr, callback) == simple::detail::tokenize_result::done) {
+        callback.json_end();
+      }
+      return builder.result();
+    }
+
+    json::value parse_parallel(std::string_view source, unsigned threads) {
+      const char* data = source.data();
+      const size_t length = source.size();
+      constexpr size_t min_bytes_per_thread = 256 * 1024;
+      if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = unsigned(std::min<size_t>(threads, length / min_bytes_per_thread + 1));
+      }
+
+      array_layout layout;
+      if (threads < 2 || !find_elements(data, length, layout) || layout.starts.size() < 2) {
+        builder_callback callback;
+        simple::run_tokenizer(data, length, callback);
+        return callback.result();
+      }
+
+      // Runs are balanced by their size in bytes rather than by element count. Run r holds elements
+      // [firsts[r], firsts[r + 1]).
+      const auto& starts = layout.starts;
+      const size_t elements = starts.size();
+      const size_t runs = std::min<size_t>(threads, elements);
+      const size_t total = layout.separators.back() - starts.front();
+      std::vector<size_t> firsts{0};
+      for (size_t r = 1; r < runs; ++r) {
+        const size_t target = starts.front() + total * r / runs;
+        const size_t first = std::lower_bound(starts.begin(), starts.end(), target) - starts.begin();
+        if (first > firsts.back() && first < elements) {
+          firsts.push_back(first);
+        }
+      }
+      firsts.push_back(elements);
+
+      std::vector<json::value> results(firsts.size() - 1);
+      std::vector<std::exception_ptr> errors(firsts.size() - 1);
+      auto parse_run = [&](size_t r) {
+        try {
+          const size_t first = firsts[r];
+          const size_t last = firsts[r + 1] - 1;
+          results[r] = parse_element_run(data + starts[first], data + layout.separators[last], data + length, last - first + 1);
+        } catch (...) {
+          errors[r] = std::current_exception();
+        }
+      };
+
+      // Calling thread takes the first run itself. If a thread cannot be started, its run is parsed here as well.
+      std::vector<std::thread> workers;
+      for (size_t r = 1; r < results.size(); ++r) {
+        try {
+          workers.emplace_back(parse_run, r);
+        } catch (const std::system_error&) {
+          parse_run(r);
+        }
+      }
+      parse_run(0);
+      for (auto& worker : workers) {
+        worker.join();
+      }
+
+      // The earliest error in document order is reported, just like sequential parse would do.
+      for (auto& error : errors) {
+        if (error) {
+          std::rethrow_exception(error);
+        }
+      }
+
+      json::value result(value_type::array);
+      result.reserve(elements);
+      for (auto& run : results) {
+        for (size_t i = 0; i < run.size(); ++i) {
+          result.push(std::move(run[i]));
+        }
+      }
+      return result;
+    }
+
+    json::value parse(std::string_view source) {
+      builder_callback callback;
+      simple::run_tokenizer(source.data(), source.size(), callback);
+      return callback.result();
+    }
+
+    json::value& parse(std::string_view source, document& target) {
+      target.clear();
+      builder_callback callback(target);
+      simple::run_tokenizer(source.data(), source.size(), callback);
+      return target.root() = callback.result();
+    }
+
+    frozen::document parse_frozen(std::string_view source) {
+      grammar_callback<frozen::builder> callback;
+      simple::run_tokenizer(source.data(), source.size(), callback);
       return callback.result();
     }
 
+    json::value parse(std::string_view source, const projection& paths) {
+      builder_callback builder;
+      projection_callback callback(builder, paths);
+      simple::run_tokenizer(source.data(), source.size(), callback);
+      return builder.result();
+    }
+
     json::value parse(std::istream& source) {
       builder_callback callback;
-      run_tokenizer(source, callback);
+      simple::run_tokenizer(source, callback);
+      return callback.result();
+    }
+
+    json::value parse_file(const std::string& path) {
+      std::unique_ptr<utils::mapped_file> file;
+      try {
+        file = std::make_unique<utils::mapped_file>(path);
+      } catch (const std::runtime_error& error) {
+        throw json::json_error(error.what());
+      }
+      builder_callback callback;
+      simple::run_tokenizer(file->data(), file->size(), callback);
       return callback.result();
     }
+
+    // RFC 7464 record separator, it may precede any top level value of a sequence.
+    constexpr char record_separator = '\x1E';
+
+    // Structural index and record offsets of a window being split, reused from window to window.
+    struct split_buffers {
+      std::vector<uint32_t> positions;
+      std::vector<std::pair<size_t, size_t>> records;
+    };
+
+    // Splits buffer into records (top level values) with the help of structural index, replacing buffers.records with
+    // their [begin, end) offsets. Returns offset of the first byte that doesn't belong to any record found: unless buffer
+    // is `final`, trailing value that might continue in the next buffer (any unfinished container or the last scalar)
+    // is left there. Anything unexpected between values (like a stray ']') becomes a record of its own, so that parsing
+    // reports it. So does a container with tokens that cannot follow each other (like `{bad`): it ends right before the
+    // offending token, rather than swallowing everything after it while waiting to be closed.
+    size_t split_records(const char* data, size_t length, bool final, split_buffers& buffers) {
+      const auto& positions = buffers.positions;
+      auto& records = buffers.records;
+      simd::build_structural_index(data, length, buffers.positions);
+      records.clear();
+
+      // Token that may follow given one inside a container. Values are indexed by their first character only.
+      auto may_follow = [](char previous, char c) {
+        const bool value = c != ',' && c != ':' && c != ']' && c != '}';
+        switch (previous) {
+        case '{': return c == '"' || c == '}';
+        case '[': return value || c == ']';
+        case ',':
+        case ':': return value;
+        default:  return !value; // After a value.
+        }
+      };
+
+      size_t consumed = 0;
+      size_t depth = 0;
+      size_t start = 0;
+      char previous = 0;      // Last token inside a container.
+      bool in_scalar = false; // Top level scalar runs until the next indexed position.
+      for (size_t i = 0; i < positions.size(); ++i) {
+        const size_t position = positions[i];
+        const char c = data[position];
+        if (depth != 0) {
+          if (may_follow(previous, c)) {
+            previous = c;
+            if (c == '[' || c == '{') {
+              ++depth;
+            } else if ((c == ']' || c == '}') && --depth == 0) {
+              records.emplace_back(start, position + 1);
+              consumed = position + 1;
+            }
+            continue;
+          }
+          records.emplace_back(start, position);
+          consumed = position;
+          depth = 0;
+        }
+
+        if (in_scalar) {
+          records.emplace_back(start, position);
+          consumed = position;
+          in_scalar = false;
+        }
+        if (c == record_separator) {
+          // Separator is indexed as a scalar start, so a scalar that immediately follows it isn't indexed on its own.
+          size_t next = position;
+          while (next != length && data[next] == record_separator) {
+            ++next;
+          }
+          consumed = next;
+          if (next != length && !simple::detail::is_whitespace(data[next]) && (i + 1 == positions.size() || positions[i + 1] != next)) {
+            start = next;
+            in_scalar = true;
+          }
+          continue;
+        }
+
+        start = position;
+        switch (c) {
+        case '[':
+        case '{':
+          depth = 1;
+          previous = c;
+          break;
+        case ']':
+        case '}':
+        case ',':
+        case ':':
+          records.emplace_back(start, position + 1);
+          consumed = position + 1;
+          break;
+        default:
+          in_scalar = true;
+        }
+      }
+
+      if (!final) {
+        return consumed;
+      }
+      if (in_scalar || depth != 0) {
+        records.emplace_back(start, length);
+      }
+      return length;
+    }
+
+    // Parses exactly one value, which may only be followed by whitespace. Index is reset to the record, so that
+    // its memory is reused from record to record.
+    json::value parse_record(const char* begin, const char* end, std::string& scratch, simple::detail::token_index& index) {
+      builder_callback callback;
+      simple::detail::cursor cur{begin, end};
+      index.reset(begin, end - begin);
+      callback.json_start();
+      if (simple::detail::tokenize(cur, index, scratch, nullptr, callback) == simple::detail::tokenize_result::done) {
+        callback.json_end();
+      }
+      if (simple::detail::skip_whitespace(cur)) {
+        throw json::json_error("Unable to parse JSON: unexpected [text=" + std::string(cur.pos, std::min<size_t>(cur.end - cur.pos, 16)) + "] after a value.");
+      }
+      return callback.result();
+    }
+
+    // Consecutive records parsed as a unit by one worker. Text is either owned by the task (it was read from
+    // stream) or belongs to the caller.
+    struct record_task {
+      size_t sequence;
+      std::shared_ptr<const std::string> storage;
+      std::vector<std::pair<const char*, const char*>> records;
+    };
+
+    // Parsed values of a task, followed by the error that stopped it (if any).
+    struct record_results {
+      std::vector<json::value> values;
+      std::exception_ptr error;
+    };
+
+    record_results parse_task(const record_task& task, std::string& scratch, simple::detail::token_index& index) {
+      record_results results;
+      results.values.reserve(task.records.size());
+      try {
+        for (const auto& record : task.records) {
+          results.values.push_back(parse_record(record.first, record.second, scratch, index));
+        }
+      } catch (...) {
+        results.error = std::current_exception();
+      }
+      return results;
+    }
+
+    // Worker pool behind parse_records. Producer submits tasks, workers parse them and deliver values to consumer
+    // under a lock (in order of task sequence numbers if delivery is ordered). Number of tasks that are submitted,
+    // but not delivered yet is bounded, so that producer doesn't run too far ahead of workers. Without worker threads
+    // tasks are parsed and delivered right in submit().
+    class record_pipeline {
+      const std::function<void(json::value&&)>& consumer;
+      const delivery order;
+      const size_t max_in_flight;
+      std::vector<std::thread> workers;
+
+      std::mutex queue_mutex;
+      std::condition_variable queue_changed;
+      std::deque<record_task> tasks;
+      size_t in_flight;
+      size_t submitted;
+      bool stopping;
+
+      std::mutex delivery_mutex;
+      std::map<size_t, record_results> completed; // Parsed out of order, waiting for their turn.
+      size_t next_delivery;
+      std::exception_ptr error;
+      std::atomic<bool> failed;
+
+      std::string scratch; // For parsing on the calling thread.
+      simple::detail::token_index index;
+
+    public:
+      record_pipeline(const std::function<void(json::value&&)>& _consumer, unsigned threads, delivery _order)
+        : consumer(_consumer), order(_order), max_in_flight(4 * size_t(threads)), workers(), queue_mutex(), queue_changed(), tasks(),
+          in_flight(0), submitted(0), stopping(false), delivery_mutex(), completed(), next_delivery(0), error(), failed(false), scratch(), index() {
+        for (unsigned i = 0; threads > 1 && i < threads; ++i) {
+          try {
+            workers.emplace_back(&record_pipeline::work, this);
+          } catch (const std::system_error&) {
+            break; // Parse with whatever we've got, possibly on the calling thread only.
+          }
+        }
+      }
+
+      ~record_pipeline() {
+        failed = true; // Only reached without finish() if producer failed, nothing is delivered after that.
+        stop();
+      }
+
+      // Returns false if pipeline has already failed, so there is no point in producing more tasks.
+      bool submit(record_task&& task) {
+        task.sequence = submitted++;
+        if (workers.empty()) {
+          if (!failed) {
+            deliver(task.sequence, parse_task(task, scratch, index));
+          }
+          return !failed;
+        }
+
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_changed.wait(lock, [this]() { return in_flight < max_in_flight || failed; });
+        if (failed) {
+          return false;
+        }
+        ++in_flight;
+        tasks.push_back(std::move(task));
+        lock.unlock();
+        queue_changed.notify_all();
+        return true;
+      }
+
+      // True once a record failed to parse or consumer threw, producer should stop then.
+      bool has_failed() const { return failed; }
+
+      // Waits for all submitted tasks to be delivered and rethrows the first error.
+      void finish() {
+        stop();
+        if (error) {
+          std::rethrow_exception(error);
+        }
+      }
+
+    private:
+      void stop() {
+        {
+          std::lock_guard<std::mutex> lock(queue_mutex);
+          stopping = true;
+        }
+        queue_changed.notify_all();
+        for (auto& worker : workers) {
+          worker.join();
+        }
+        workers.clear();
+      }
+
+      void work() {
+        std::string worker_scratch;
+        simple::detail::token_index worker_index;
+        while (true) {
+          std::unique_lock<std::mutex> lock(queue_mutex);
+          queue_changed.wait(lock, [this]() { return stopping || !tasks.empty(); });
+          if (tasks.empty()) {
+            return;
+          }
+          record_task task = std::move(tasks.front());
+          tasks.pop_front();
+          lock.unlock();
+
+          size_t delivered = failed ? 1 : deliver(task.sequence, parse_task(task, worker_scratch, worker_index));
+          lock.lock();
+          in_flight -= delivered;
+          lock.unlock();
+          queue_changed.notify_all();
+        }
+      }
+
+      // Hands results over to consumer (or parks them until their turn comes), returns number of tasks delivered.
+      size_t deliver(size_t sequence, record_results&& results) {
+        std::lock_guard<std::mutex> lock(delivery_mutex);
+        if (order == delivery::unordered) {
+          deliver_values(results);
+          return 1;
+        }
+        completed.emplace(sequence, std::move(results));
+        size_t delivered = 0;
+        for (auto it = completed.begin(); it != completed.end() && it->first == next_delivery; it = completed.erase(it)) {
+          deliver_values(it->second);
+          ++next_delivery;
+          ++delivered;
+        }
+        return delivered;
+      }
+
+      void deliver_values(record_results& results) {
+        if (failed) {
+          return;
+        }
+        try {
+          for (auto& value : results.values) {
+            consumer(std::move(value));
+          }
+        } catch (...) {
+          fail(std::current_exception());
+          return;
+        }
+        if (results.error) {
+          fail(results.error);
+        }
+      }
+
+      void fail(std::exception_ptr reason) {
+        error = reason;
+        failed = true;
+      }
+    };
+
+    // Groups records into tasks of roughly this much text, so that locking cost is negligible.
+    constexpr size_t task_bytes = 64 * 1024;
+
+    // Records are split in windows of this much text, so that index of a window stays small. A window that doesn't
+    // contain a single complete record is grown until it does.
+    constexpr size_t split_bytes = 1024 * 1024;
+
+    // Submits records found in [data, data + length) as tasks, sets consumed to offset of the unconsumed tail (see
+    // split_records). Returns false as soon as pipeline has failed, leaving the rest of records unsubmitted.
+    bool submit_records(record_pipeline& pipeline, split_buffers& buffers, const char* data, size_t length, bool final,
+                        const std::shared_ptr<const std::string>& storage, size_t& consumed) {
+      record_task task{0, storage, {}};
+      const char* task_start = nullptr;
+      size_t window = split_bytes;
+      consumed = 0;
+      while (consumed != length) {
+        const char* begin = data + consumed;
+        const size_t size = std::min(window, length - consumed);
+        const bool last = consumed + size == length;
+        const size_t split = split_records(begin, size, final && last, buffers);
+        for (const auto& record : buffers.records) {
+          if (task.records.empty()) {
+            task_start = begin + record.first;
+          }
+          task.records.emplace_back(begin + record.first, begin + record.second);
+          if (size_t(begin + record.second - task_start) >= task_bytes) {
+            if (!pipeline.submit(std::move(task))) {
+              return false;
+            }
+            task = record_task{0, storage, {}};
+          }
+        }
+        consumed += split;
+        if (last) {
+          break; // Unless final, the rest waits for the next buffer.
+        }
+        if (split == 0 && size == UINT32_MAX) {
+          throw json::json_error("Unable to parse JSON: a single record exceeds 4GiB.");
+        }
+        window = split == 0 ? std::min<size_t>(2 * window, UINT32_MAX) : split_bytes;
+      }
+      if (!task.records.empty() && !pipeline.submit(std::move(task))) {
+        return false;
+      }
+      return !pipeline.has_failed();
+    }
+
+    unsigned record_threads(unsigned threads) {
+      return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void parse_records(std::string_view source, const std::function<void(value&&)>& consumer, unsigned threads, delivery order) {
+      record_pipeline pipeline(consumer, record_threads(threads), order);
+      split_buffers buffers;
+      size_t consumed = 0;
+      submit_records(pipeline, buffers, source.data(), source.size(), true, nullptr, consumed); // Error is rethrown by finish().
+      pipeline.finish();
+    }
+
+    void parse_records(std::istream& source, const std::function<void(value&&)>& consumer, unsigned threads, delivery order) {
+      if (!source) {
+        throw json::json_error("Unable to proceed with reading: given stream is broken.");
+      }
+
+      // Unconsumed tail of a block is carried over into the next one. Blocks grow together with the tail, so
+      // a value spanning many blocks is rescanned only a logarithmic number of times.
+      constexpr size_t block_bytes = 1024 * 1024;
+      record_pipeline pipeline(consumer, record_threads(threads), order);
+      split_buffers buffers;
+      std::string tail;
+      bool final = false;
+      while (!final && !pipeline.has_failed()) {
+        auto block = std::make_shared<std::string>(std::move(tail));
+        const size_t offset = block->size();
+        const size_t wanted = std::min<size_t>(std::max(block_bytes, offset), UINT32_MAX - offset);
+        if (wanted == 0) {
+          throw json::json_error("Unable to parse JSON: a single record exceeds 4GiB.");
+        }
+        block->resize(offset + wanted);
+        source.read(&(*block)[offset], std::streamsize(wanted));
+        block->resize(offset + size_t(source.gcount()));
+        if (source.bad()) {
+          throw json::json_error("Unable to proceed with reading: stream failed while reading.");
+        }
+        final = !source;
+
+        size_t consumed = 0;
+        if (!submit_records(pipeline, buffers, block->data(), block->size(), final, block, consumed)) {
+          break; // Error is rethrown by finish().
+        }
+        tail.assign(*block, consumed, std::string::npos);
+      }
+      pipeline.finish();
+    }
+
+    std::vector<json::value> parse_records(std::string_view source, unsigned threads) {
+      std::vector<json::value> values;
+      parse_records(source, [&values](json::value&& value) { values.push_back(std::move(value)); }, threads, delivery::ordered);
+      return values;
+    }
+
+    // Tokenizer keeps a reference to callback, so both live together.
+    struct push_parser::state {
+      builder_callback callback;
+      simple::push_tokenizer<builder_callback> tokenizer;
+
+      state() : callback(), tokenizer(callback) {}
+    };
+
+    push_parser::push_parser() : impl(std::make_unique<state>()) {}
+    push_parser::~push_parser() = default;
+    push_parser::push_parser(push_parser&&) = default;
+    push_parser& push_parser::operator=(push_parser&&) = default;
+
+    bool push_parser::feed(const char* data, size_t length) {
+      return impl->tokenizer.feed(data, length);
+    }
+
+    bool push_parser::feed(const std::string& chunk) {
+      return feed(chunk.data(), chunk.size());
+    }
+
+    json::value push_parser::finish() {
+      impl->tokenizer.finish();
+      return impl->callback.result();
+    }
+
+    struct context::state {
+      simple::tokenizer_buffers buffers;
+      builder_callback builder;
+      grammar_callback<tree_updater> updater;
+    };
+
+    context::context() : impl(std::make_unique<state>()) {}
+    context::~context() = default;
+    context::context(context&&) = default;
+    context& context::operator=(context&&) = default;
+
+    json::value context::parse(std::string_view source) {
+      simple::run_tokenizer(source.data(), source.size(), impl->builder, impl->buffers);
+      return impl->builder.result();
+    }
+
+    json::value& context::parse_into(std::string_view source, value& target) {
+      impl->updater.sink.attach(target);
+      simple::run_tokenizer(source.data(), source.size(), impl->updater, impl->buffers);
+      return target;
+    }
   }
 }
@@ -2,17 +2,122 @@
 #define _JSON_PARSER_H_
 
 #include "json.h"
+#include "json_frozen.h"
+#include <functional>
+#include <initializer_list>
+#include <map>
 #include <string>
+#include <string_view>
 #include <istream>
+#include <memory>
+#include <vector>
 
 namespace json {
   namespace parser {
     // Parses given string and returns first fully parsed value. If anything goes wrong,
     // throws json::json_error
-    value parse(const std::string&);
+    value parse(std::string_view);
     // Parses given stream and returns first fully parsed value. If anything goes wrong,
     // throws json::json_error
     value parse(std::istream&);
+    // Parses file at given path and returns first fully parsed value. File is memory-mapped
+    // (see utils::mapped_file) and tokenized straight from the mapping, so besides the mapping and the tree
+    // parsing only takes a window of structural index, whatever the size of the file. If anything goes wrong,
+    // throws json::json_error
+    value parse_file(const std::string& path);
+    // Parses given string right into the arena of given document and returns the new root. Previous contents of
+    // the document are dropped (see document::clear). If anything goes wrong, throws json::json_error
+    value& parse(std::string_view, document&);
+    // Parses given string straight into a frozen document (see json_frozen.h), without building a tree first. If
+    // anything goes wrong, throws json::json_error
+    frozen::document parse_frozen(std::string_view);
+
+    // Set of paths to keep when parsing with projection. Paths are JSON Pointers (RFC 6901) like "/friends/0/name",
+    // where "*" segment matches any object key or array index (hence key "*" cannot be selected on its own).
+    // Empty path selects the whole document. Throws json::json_error if a path is malformed.
+    class projection {
+      // Paths are compiled into a deterministic automaton: each node knows where every key leads.
+      struct node {
+        std::map<std::string, size_t, std::less<>> children; // Keys mentioned explicitly.
+        size_t others;                                     // Any other key or index, `none` if it is dropped.
+        bool whole;                                        // Whole value is kept.
+      };
+      static constexpr size_t none = size_t(-1);
+      std::vector<node> nodes;                             // Root is the first one.
+      friend class projection_callback;
+    public:
+      projection(std::initializer_list<std::string_view> paths);
+      explicit projection(const std::vector<std::string>& paths);
+    };
+
+    // Parses given string, but keeps only values at paths of the projection (together with objects and arrays
+    // on the way to them), everything else is skipped by the tokenizer without being parsed. Array elements that
+    // are not selected are dropped, so indices in result may differ from the ones in input. If anything goes wrong,
+    // throws json::json_error (contents of skipped values are not validated though)
+    value parse(std::string_view, const projection&);
+
+    // Parses given buffer just like parse() does, but if top level value is an array its elements are split
+    // into contiguous runs that are parsed on up to `threads` threads (0 means one per hardware thread,
+    // limited so that tiny documents are not split at all) and stitched back in order. Documents of any
+    // other shape are parsed sequentially. If anything goes wrong, throws json::json_error
+    value parse_parallel(std::string_view, unsigned threads = 0);
+
+    // Order in which parse_records() hands values over to consumer.
+    enum class delivery { ordered, unordered };
+
+    // Parses a sequence of JSON values: JSON Lines (NDJSON), RFC 7464 JSON text sequences (records prefixed
+    // with 0x1E) or simply concatenated values, calling consumer with each of them. Input is split into records
+    // in bulk and records are parsed on `threads` worker threads (0 means one per hardware thread, 1 means
+    // parsing on the calling thread). Ordered delivery preserves input order, unordered one passes values on as
+    // soon as they are parsed. Consumer is never called concurrently, but might be called from worker threads.
+    // Parsing stops at the first malformed record (with ordered delivery all values preceding it are delivered)
+    // or the first exception thrown by consumer, which is then rethrown. Malformed input throws json::json_error
+    void parse_records(std::string_view, const std::function<void(value&&)>& consumer, unsigned threads = 0, delivery = delivery::ordered);
+    // Same as above, input is read from stream in blocks while previous blocks are being parsed.
+    void parse_records(std::istream&, const std::function<void(value&&)>& consumer, unsigned threads = 0, delivery = delivery::ordered);
+    // Returns all values of given sequence in input order.
+    std::vector<value> parse_records(std::string_view, unsigned threads = 0);
+
+    // Long-lived parsing state, meant to be kept around (one per thread) for parsing many documents in a row: stacks
+    // of the parser, structural index and string buffers keep their memory between parses. Parsing into an existing
+    // value reuses its nodes as well, so that similarly shaped documents are parsed with next to no allocations.
+    class context {
+      struct state;
+      std::unique_ptr<state> impl;
+    public:
+      context();
+      ~context();
+      context(context&&);
+      context& operator=(context&&);
+
+      // Same as parser::parse(std::string_view).
+      value parse(std::string_view);
+      // Parses given string over given value and returns it. Every parsed value is written over the one at the same
+      // place (same key or index) of the target, so containers and strings that are there already are reused, and
+      // entries or elements that are not in the input are removed. Target keeps its memory resource. If anything goes
+      // wrong, throws json::json_error and target is left partially updated.
+      value& parse_into(std::string_view, value& target);
+    };
+
+    // Incremental parser for input that arrives in chunks: each chunk is parsed as soon as it is fed, only
+    // a token cut by the chunk boundary is carried over. Parses the first value, just like parse().
+    class push_parser {
+      struct state;
+      std::unique_ptr<state> impl;
+    public:
+      push_parser();
+      ~push_parser();
+      push_parser(push_parser&&);
+      push_parser& operator=(push_parser&&);
+
+      // Parses next chunk of input. Returns true while more input is needed to complete the value.
+      // If anything goes wrong, throws json::json_error
+      bool feed(const char*, size_t);
+      bool feed(const std::string&);
+      // Signals that there is no more input and returns parsed value. If input was incomplete or malformed,
+      // throws json::json_error
+      value finish();
+    };
   }
 }
 
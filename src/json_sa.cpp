@@ -1,205 +1,423 @@
 #include "json_sa.h"
+#include "json_number.h"
+#include "json_simd.h"
 #include "utils.h"
 
-#include <cctype>
-#include <memory>
-#include <vector>
-#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <istream>
-#include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace json {
   namespace simple {
 
-    // Tokenizer error - not visible to outside world, used to convey information about 
-    // tokenizing failure.
-    struct tokenizer_error : public std::runtime_error {
-      tokenizer_error(const std::string reason) : std::runtime_error(reason) {}
-    };
-
-    // Tries to consume given literal from given stream.
-    // Since literal is known at call time and might not correspond to any meaningful value (ex. in case of null) doesn't
-    // return anything. 
-    void read_literal(std::istream& is, const std::string& literal) {
-      auto len = literal.length();
-
-      unsigned int i = 0;
-      while (is && i < len) {
-        if (is.get() != literal[i]) {
-          break;
-        }
-        ++i;
+    namespace detail {
+
+      // Docs in header.
+      token_index::token_index(const char* _data, size_t length) : token_index() {
+        reset(_data, length);
       }
 
-      if (!is || i != len) {
-        throw tokenizer_error("Failed to read [literal=" + literal + "][stream_state=" + utils::to_string((bool)is) + "][read=" + utils::to_string(i) + "]");
+      // Docs in header.
+      void token_index::reset(const char* data, size_t length) {
+        base = data;
+        indexed = data;
+        end = data + length;
+        enabled = true;
+        positions.clear();
+        next = last = positions.data();
       }
-    }
 
-    // Reads JSON string from given stream. Assumes that JSON string terminates with first
-    // non-escaped '"' (another way would be to check that first char is '"' and pass whole string here,
-    // but it looks superfluous).
-    std::string read_string(std::istream& is) {
-      std::string target;
-      std::string::value_type c;
-
-      bool escaped = true;
-      std::ios::fmtflags in_flags(is.flags());
-      is >> std::noskipws;
-      while (is) {
-        is >> c;
-        if (!is) {
-          is.flags(in_flags);
-          throw tokenizer_error("Failed to read string due to a stream error.");
-        }
+      // Docs in header.
+      void token_index::advance(const char* from) {
+        base = from;
+        indexed = from + std::min<size_t>(window_bytes, end - from);
+        simd::build_structural_index(from, indexed - from, positions);
+        next = positions.data();
+        last = next + positions.size();
+      }
 
-        if (c == '"' && !escaped) {
-          is.flags(in_flags);
-          return target;
+      // Tries to consume given literal from given buffer.
+      // Since literal is known at call time and might not correspond to any meaningful value (ex. in case of null) doesn't
+      // return anything.
+      void read_literal(cursor& cur, const char* literal, size_t len) {
+        size_t i = 0;
+        while (cur.pos != cur.end && i < len) {
+          if (*cur.pos != literal[i]) {
+            break;
+          }
+          ++cur.pos;
+          ++i;
         }
 
-        escaped = (c == '\\' && !escaped);
-        target.push_back(c);
+        if (i != len) {
+          if (cur.pos == cur.end) {
+            throw incomplete_input("Failed to read [literal=" + std::string(literal) + "]: input ended after [read=" + utils::to_string(i) + "]");
+          }
+          throw tokenizer_error("Failed to read [literal=" + std::string(literal) + "][at_end=" + utils::to_string(cur.pos == cur.end) + "][read=" + utils::to_string(i) + "]");
+        }
       }
-      
-      is.flags(in_flags);
-
-      throw tokenizer_error("Failed to read string: unterminated string encountered.");
-    }
 
-    // Reads JSON number. As per JSON spec (json.org) numbers should have . as their decimal
-    // separators. One way to ensure that would be to enforce locale on input streams, but it might
-    // have averse effects on characters reading so I went for bit uglier, but safe approach here.
-    double read_number(std::istream& is) {
-      const auto classic_locale = std::locale::classic();
-      auto original_locale = is.imbue(classic_locale); // Imbue with C locale to force decimal separator to . (some of locales use ,)
-      double val;
-      is >> val;
-      is.imbue(original_locale);
-      if (!is) {
-        throw tokenizer_error("Failed to read number due to a stream error.");
+      // Reads exactly four hex digits of \\uXXXX escape.
+      unsigned read_hex4(cursor& cur) {
+        if (cur.end - cur.pos < 4) {
+          throw incomplete_input("Failed to read string: truncated \\u escape.");
+        }
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i) {
+          char c = *cur.pos++;
+          code <<= 4;
+          if (c >= '0' && c <= '9') {
+            code |= c - '0';
+          } else if (c >= 'a' && c <= 'f') {
+            code |= c - 'a' + 10;
+          } else if (c >= 'A' && c <= 'F') {
+            code |= c - 'A' + 10;
+          } else {
+            throw tokenizer_error("Failed to read string: invalid hex digit '" + std::string(1, c) + "' in \\u escape.");
+          }
+        }
+        return code;
       }
-      return val; 
-    }
 
-    // Docs in header.
-    void run_tokenizer(const std::string& source, token_callback& callback) {
-      if (source.empty()) {
-        callback.json_error("Cannot parse an empty string, top level value in JSON should be one of 'true', 'false', 'null', a string literal, an object or an array.");
-        return;
+      // Appends UTF-8 encoding of given code point.
+      void append_utf8(std::string& target, unsigned code_point) {
+        if (code_point < 0x80) {
+          target.push_back(char(code_point));
+        } else if (code_point < 0x800) {
+          target.push_back(char(0xC0 | (code_point >> 6)));
+          target.push_back(char(0x80 | (code_point & 0x3F)));
+        } else if (code_point < 0x10000) {
+          target.push_back(char(0xE0 | (code_point >> 12)));
+          target.push_back(char(0x80 | ((code_point >> 6) & 0x3F)));
+          target.push_back(char(0x80 | (code_point & 0x3F)));
+        } else {
+          target.push_back(char(0xF0 | (code_point >> 18)));
+          target.push_back(char(0x80 | ((code_point >> 12) & 0x3F)));
+          target.push_back(char(0x80 | ((code_point >> 6) & 0x3F)));
+          target.push_back(char(0x80 | (code_point & 0x3F)));
+        }
       }
 
-      std::stringstream is(source);
+      // Decodes escape sequence, cursor is expected to point right after the backslash.
+      // \\uXXXX escapes are UTF-16 code units, so surrogate pairs are combined into a single code point.
+      void read_escape(cursor& cur, std::string& target) {
+        if (cur.pos == cur.end) {
+          throw incomplete_input("Failed to read string: unterminated string encountered.");
+        }
+        char c = *cur.pos++;
+        switch (c) {
+        case '"':  target.push_back('"');  break;
+        case '\\': target.push_back('\\'); break;
+        case '/':  target.push_back('/');  break;
+        case 'b':  target.push_back('\b'); break;
+        case 'f':  target.push_back('\f'); break;
+        case 'n':  target.push_back('\n'); break;
+        case 'r':  target.push_back('\r'); break;
+        case 't':  target.push_back('\t'); break;
+        case 'u': {
+          unsigned code_point = read_hex4(cur);
+          if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+            throw tokenizer_error("Failed to read string: unpaired low surrogate in \\u escape.");
+          }
+          if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+            if (cur.end - cur.pos < 2 && (cur.pos == cur.end || cur.pos[0] == '\\')) {
+              throw incomplete_input("Failed to read string: input ended inside surrogate pair.");
+            }
+            if (cur.end - cur.pos < 2 || cur.pos[0] != '\\' || cur.pos[1] != 'u') {
+              throw tokenizer_error("Failed to read string: unpaired high surrogate in \\u escape.");
+            }
+            cur.pos += 2;
+            unsigned low = read_hex4(cur);
+            if (low < 0xDC00 || low > 0xDFFF) {
+              throw tokenizer_error("Failed to read string: high surrogate is not followed by low one in \\u escape.");
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+          }
+          append_utf8(target, code_point);
+          break;
+        }
+        default:
+          throw tokenizer_error("Failed to read string: invalid escape sequence '\\" + std::string(1, c) + "'.");
+        }
+      }
 
-      run_tokenizer(is, callback);
-    }
+      // Reads JSON string from given buffer, decoding escape sequences. Assumes that JSON string terminates with first
+      // non-escaped '"' (another way would be to check that first char is '"' and pass whole string here,
+      // but it looks superfluous). Runs without escapes are located with vectorized search and copied in one go.
+      // Strings without escapes are returned as views into the buffer, others are decoded into `scratch`
+      // (its previous contents are dropped, but capacity is reused).
+      std::string_view read_string(cursor& cur, std::string& scratch) {
+        const char* special = simd::find_quote_or_backslash(cur.pos, cur.end);
+        if (special != cur.end && *special == '"') {
+          std::string_view result(cur.pos, special - cur.pos);
+          cur.pos = special + 1;
+          return result;
+        }
 
-    // Docs in header.
-    void run_tokenizer(std::istream& is, token_callback& callback) {
-      const std::string null_literal = "null";
-      const std::string true_literal = "true";
-      const std::string false_literal = "false";
+        scratch.clear();
+        while (true) {
+          if (special == cur.end) {
+            throw incomplete_input("Failed to read string: unterminated string encountered.");
+          }
+          scratch.append(cur.pos, special);
+          cur.pos = special + 1;
+          if (*special == '"') {
+            return scratch;
+          }
+          read_escape(cur, scratch);
+          special = simd::find_quote_or_backslash(cur.pos, cur.end);
+        }
+      }
 
-      if (!is) {
-        callback.json_error("Unable to proceed with reading: given stream is broken.");
-        return;
+      // Missing digits at the very end of input might still arrive later.
+      [[noreturn]] void number_error(const cursor& cur, const std::string& reason) {
+        if (cur.pos == cur.end) {
+          throw incomplete_input(reason);
+        }
+        throw tokenizer_error(reason);
       }
 
-      callback.json_start();
+      // Reads JSON number. Number text is validated against the JSON grammar (json.org):
+      // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+      // and the longest matching prefix is consumed. Digits are accumulated into decimal mantissa and
+      // exponent along the way, so conversion doesn't need to look at the text again in all but rare cases.
+      double read_number(cursor& cur) {
+        const char* start = cur.pos;
+        numbers::decimal number{0, 0, false, false};
+        int significant_digits = 0;
 
-      while (is && callback.need_more_json()) {
-        is >> std::ws;
-        if (!is) {
-          callback.json_error("Unable to proceed with reading: skip whitespaces for some inexplicable reason.");
-          return;
+        // Mantissa keeps up to 19 significant digits, the rest only matter for exponent (integer part)
+        // or for knowing that we've lost something (any non-zero digit dropped).
+        auto digits = [&cur, &number, &significant_digits](bool fraction) {
+          const char* from = cur.pos;
+          while (cur.pos != cur.end && is_digit(*cur.pos)) {
+            unsigned digit = *cur.pos - '0';
+            if (significant_digits < 19) {
+              number.mantissa = number.mantissa * 10 + digit;
+              if (number.mantissa != 0) {
+                ++significant_digits;
+              }
+              if (fraction) {
+                --number.exponent;
+              }
+            } else {
+              number.truncated |= digit != 0;
+              if (!fraction) {
+                ++number.exponent;
+              }
+            }
+            ++cur.pos;
+          }
+          return cur.pos - from;
+        };
+
+        if (*cur.pos == '-') {
+          number.negative = true;
+          ++cur.pos;
         }
-        auto c = is.peek();
-        if (!is) {
-          callback.json_error("Unable to proceed with reading: unable to read char.");
-          return;
+        if (cur.pos != cur.end && *cur.pos == '0') {
+          ++cur.pos;
+          if (cur.pos != cur.end && is_digit(*cur.pos)) {
+            throw tokenizer_error("Failed to read number: leading zeros are not allowed.");
+          }
+        } else if (digits(false) == 0) {
+          number_error(cur, "Failed to read number: no digits in integer part.");
         }
-        
-        switch (c) {
-        case 'n':
-          try {
-            read_literal(is, null_literal);
-            callback.json_null();
-            break;
-          } catch (const tokenizer_error& error) {
-            callback.json_error(error.what());
-            return; // Return here and below because we cannot rely on callback.neet_more_json() to return false
-                    // even after error and is could be readable
+        if (cur.pos != cur.end && *cur.pos == '.') {
+          ++cur.pos;
+          if (digits(true) == 0) {
+            number_error(cur, "Failed to read number: no digits in fraction part.");
           }
-        case 't':
-          try {
-            read_literal(is, true_literal);
-            callback.json_boolean(true);
-            break;
-          } catch (const tokenizer_error& error) {
-            callback.json_error(error.what());
-            return;
+        }
+        if (cur.pos != cur.end && (*cur.pos == 'e' || *cur.pos == 'E')) {
+          ++cur.pos;
+          bool negative_exponent = false;
+          if (cur.pos != cur.end && (*cur.pos == '+' || *cur.pos == '-')) {
+            negative_exponent = *cur.pos == '-';
+            ++cur.pos;
+          }
+          const char* from = cur.pos;
+          int64_t exponent = 0;
+          while (cur.pos != cur.end && is_digit(*cur.pos)) {
+            if (exponent < 1000000) { // Anything beyond is zero or infinity anyway.
+              exponent = exponent * 10 + (*cur.pos - '0');
+            }
+            ++cur.pos;
+          }
+          if (cur.pos == from) {
+            number_error(cur, "Failed to read number: no digits in exponent.");
+          }
+          number.exponent += negative_exponent ? -exponent : exponent;
+        }
+
+        double val;
+        if (!numbers::to_double(number, start, cur.pos, val)) {
+          throw tokenizer_error("Failed to read number: [number=" + std::string(start, cur.pos) + "] is out of range.");
+        }
+        return val;
+      }
+
+      // Docs in header.
+      bool read_partial_string(cursor& cur, std::string& scratch, partial_token& state, std::string_view& result) {
+        const char* begin = cur.pos + 1; // Past the opening quote.
+        const char* pos = cur.pos + std::max<size_t>(state.scanned, 1);
+        while (true) {
+          const char* special = simd::find_quote_or_backslash(pos, cur.end);
+          if (special == cur.end) {
+            if (state.decoded) {
+              scratch.append(pos, special);
+            }
+            state.scanned = special - cur.pos;
+            return false;
+          }
+          if (*special == '"') {
+            if (state.decoded) {
+              scratch.append(pos, special);
+              result = scratch;
+            } else {
+              result = std::string_view(begin, special - begin);
+            }
+            cur.pos = special + 1;
+            return true;
+          }
+
+          if (state.decoded) {
+            scratch.append(pos, special);
+          } else {
+            scratch.assign(begin, special);
+            state.decoded = true;
           }
-        case 'f':
+          // Escape that is cut short is decoded again once the rest of it arrives.
+          cursor escape{special + 1, cur.end};
+          const size_t decoded = scratch.size();
           try {
-            read_literal(is, false_literal);
-            callback.json_boolean(false);
-            break;
-          } catch (const tokenizer_error& error) {
-            callback.json_error(error.what());
-            return;
+            read_escape(escape, scratch);
+          } catch (const incomplete_input&) {
+            scratch.resize(decoded);
+            state.scanned = special - cur.pos;
+            return false;
           }
-        case '{':
-          is.get();
-          callback.json_object_starts();
-          break;
-        case '}':
-          is.get();
-          callback.json_object_ends();
-          break;
+          pos = escape.pos;
+        }
+      }
+
+      // Skips a scalar without validating it: it ends at the first whitespace or structural character.
+      void skip_scalar(cursor& cur) {
+        while (cur.pos != cur.end && !is_whitespace(*cur.pos) && *cur.pos != ',' && *cur.pos != ']' && *cur.pos != '}' && *cur.pos != ':') {
+          ++cur.pos;
+        }
+      }
+
+      // Docs in header. Arrays and objects are passed over by bracket matching: only brackets and strings (which may
+      // contain brackets) are looked at.
+      bool skip_partial(cursor& cur, partial_token& state) {
+        const char c = *cur.pos;
+        if (c != '"' && c != '[' && c != '{') {
+          skip_scalar(cur);
+          return true;
+        }
+
+        const char* pos = cur.pos + state.scanned;
+        while (true) {
+          if (state.in_string) {
+            const char* special = simd::find_quote_or_backslash(pos, cur.end);
+            if (special == cur.end || (*special == '\\' && cur.end - special < 2)) {
+              state.scanned = special - cur.pos;
+              return false;
+            }
+            if (*special == '\\') {
+              pos = special + 2; // Escaped character can't terminate the string.
+              continue;
+            }
+            pos = special + 1;
+            state.in_string = false;
+          } else {
+            pos = simd::find_quote_or_bracket(pos, cur.end);
+            if (pos == cur.end) {
+              state.scanned = pos - cur.pos;
+              return false;
+            }
+            const char bracket = *pos++;
+            if (bracket == '"') {
+              state.in_string = true;
+              continue;
+            }
+            if (bracket == '[' || bracket == '{') {
+              ++state.depth;
+              continue;
+            }
+            --state.depth;
+          }
+          if (state.depth == 0) {
+            cur.pos = pos;
+            return true;
+          }
+        }
+      }
+
+      // Skips a value starting at the cursor, see skip_partial and skip_scalar. Contents of arrays and objects are not
+      // validated.
+      void skip_value(cursor& cur) {
+        switch (*cur.pos) {
+        case '"':
         case '[':
-          is.get();
-          callback.json_array_starts();
-          break;
+        case '{': {
+          partial_token state;
+          state.start(partial_token::skipped);
+          if (!skip_partial(cur, state)) {
+            throw incomplete_input(*cur.pos == '"' ? "Failed to skip string: unterminated string encountered." : "Failed to skip value: unterminated array or object encountered.");
+          }
+          return;
+        }
         case ']':
-          is.get();
-          callback.json_array_ends();
-          break;
-        case ':':
-          is.get();
-          callback.json_colon();
-          break;
+        case '}':
         case ',':
-          is.get();
-          callback.json_comma();
-          break;
-        case '"': 
-          is.get(); // Drop the '"'
-          try {
-            callback.json_string(read_string(is));
-            break;
-          } catch (const tokenizer_error& error) {
-            callback.json_error(error.what());
-            return;
-          }
+        case ':':
+          throw tokenizer_error("Failed to skip value: [character=" + std::string(1, *cur.pos) + "] cannot start a value.");
         default:
-          if (c == '-' || std::isdigit(c)) {
-            try {
-              callback.json_number(read_number(is));
-              break;
-            } catch (const tokenizer_error& error) {
-              callback.json_error(error.what());
-              return;
-            }
-          } else {
-            callback.json_error("Unknown character was read: '" + utils::to_string(c) + "', terminating.");
-            return;
-          } 
+          skip_scalar(cur);
+        }
+      }
+
+      // Docs in header.
+      void read_stream(std::istream& is, std::string& buffer) {
+        if (!is) {
+          throw tokenizer_error("Unable to proceed with reading: given stream is broken.");
+        }
+
+        // Reading in big blocks keeps number of virtual calls into streambuf negligible.
+        constexpr std::streamsize block_size = 64 * 1024;
+        std::streamsize read = 0;
+        do {
+          auto offset = buffer.size();
+          buffer.resize(offset + block_size);
+          is.read(&buffer[offset], block_size);
+          read = is.gcount();
+          buffer.resize(offset + read);
+        } while (is && read == block_size);
+
+        if (is.bad()) {
+          throw tokenizer_error("Unable to proceed with reading: stream failed while reading.");
         }
       }
+    }
+
+    // Docs in header.
+    void run_tokenizer(const char* data, size_t length, token_callback& callback) {
+      run_tokenizer<token_callback>(data, length, callback);
+    }
+
+    // Docs in header.
+    void run_tokenizer(const std::string& source, token_callback& callback) {
+      run_tokenizer<token_callback>(source, callback);
+    }
 
-      // Given code structure, this call is likely unneeded, but can be used to do some finalization
-      callback.json_end();
+    // Docs in header.
+    void run_tokenizer(std::istream& is, token_callback& callback) {
+      run_tokenizer<token_callback>(is, callback);
     }
   }
 }
@@ -5,7 +5,14 @@
 // and it allows writing DOM-based parser more easily.
 
 #include <string>
+#include <string_view>
 #include <istream>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace json {
   namespace simple {
@@ -24,6 +31,12 @@ namespace json {
 
       // Invoked when a JSON string is read. The string that was read is the argument.
       virtual void json_string(const std::string&) {}
+      // Zero-copy flavour of json_string, this is what tokenizer actually invokes. The view points either straight
+      // into the input buffer (if string has no escapes) or into tokenizer's scratch buffer that is reused
+      // for the next string, so it's only valid for the duration of the call.
+      // Default implementation materializes the string and forwards it to json_string(), override this one
+      // instead to avoid an allocation per string token.
+      virtual void json_string_view(std::string_view str) { json_string(std::string(str)); }
       // Invoked when a JSON number is read.
       virtual void json_number(double) {}
       // Invoked when a JSON boolean is read.
@@ -46,6 +59,13 @@ namespace json {
       // Invoked when array closing bracket is read (})
       virtual void json_object_ends() {}
 
+      // Polled before every token that starts a value. Returning true makes tokenizer skip the whole value (a scalar,
+      // or an entire array/object which is passed over by bracket matching without validating its contents) and
+      // report it with json_value_skipped() instead of emitting its tokens.
+      virtual bool skip_next_value() { return false; }
+      // Invoked in place of tokens of a value that was skipped at callback's request.
+      virtual void json_value_skipped() {}
+
       // Invoked when json tokenizer encounters an error in token or stream operation.
       // Since tokenizer itself doesn't know about JSON file structure, errors like
       // mismatched brackets should be handled by callback.
@@ -57,22 +77,502 @@ namespace json {
       virtual bool need_more_json() { return false; }
     };
 
-    // Runs tokenizer on given string, feeding tokens to given callback.
-    // Actually delegates work to stream-based version, constructing stringstream from given string, so
-    // more detailed doc there.
-    void run_tokenizer(const std::string&, token_callback&);
-
-    // Runs tokenizer on a given input stream, feeding tokens to given callback.
+    // Runs tokenizer on a contiguous buffer of given length, feeding tokens to given callback.
+    // This is the workhorse: every other overload ends up here. The buffer is scanned with a plain pointer
+    // and doesn't have to be null-terminated, it only has to outlive the call.
     // Attempts to contain any parsing exceptions instead propagating them into callback.json_error()
     // invocations. Stops after first error (another arguably better solution would be to throw exception to caller,
     // but that requires exposing exception type and forces callers to try/catch for parse errors, whereas
     // they might not be interested in errors).
     // callback is passed as a mutable reference to allow calling methods not marked const (see comment for token_callback)
-    // if (!is) checks could be replaced with setting exception flags on 'is' to make it throw if any error occurs and wrap into
-    // some meaningful exception in a top-level try/catch
-    // Parsing continues either until stream encounters eof or callback decides that it has had enough and
-    // returns false on need_more_json() invocation.
+    // Parsing continues either until the buffer is exhausted or callback decides that it has had enough and
+    // returns false on need_more_json() invocation. Running out of input while callback still wants more
+    // is reported as an error.
+    //
+    // Callback is a template parameter, so calls into it are resolved statically and can be inlined into the
+    // token loop. It has to provide the same member functions token_callback has (deriving from token_callback
+    // and marking the class final is the easiest way to get there). Non-template overloads below
+    // take token_callback and dispatch virtually.
+    template<typename Callback>
+    void run_tokenizer(const char*, size_t, Callback&);
+
+    // Memory a tokenizer run needs: structural index and decoded strings. Keeping an instance around and passing it
+    // to consecutive runs spares allocating them over and over again.
+    struct tokenizer_buffers;
+
+    // Same as above, but the buffers are reused.
+    template<typename Callback>
+    void run_tokenizer(const char*, size_t, Callback&, tokenizer_buffers&);
+
+    // Runs tokenizer on given string. Scans string contents in place (no copy is made), see
+    // the buffer-based version for details.
+    template<typename Callback>
+    void run_tokenizer(const std::string&, Callback&);
+
+    // Runs tokenizer on a given input stream, feeding tokens to given callback.
+    // This is a thin adapter: the stream is drained into an internal buffer in large blocks and the
+    // buffer-based version does the actual work, so stream is consumed completely even if callback
+    // stops early.
+    template<typename Callback>
+    void run_tokenizer(std::istream&, Callback&);
+
+    namespace detail {
+      // Token cut short by the end of a chunk, see push_tokenizer. Strings and skipped values can be arbitrarily
+      // long, so the scan of those is resumed where it stopped rather than started over once more input arrives.
+      // Other tokens are short and are simply read again.
+      struct partial_token {
+        enum kind_type { none, string, skipped };
+
+        kind_type kind;
+        size_t scanned;  // Bytes of the token scanned so far, the scan continues from there.
+        size_t depth;    // Skipped array or object: brackets open at that point.
+        bool in_string;  // Skipped value: that point is inside a string.
+        bool decoded;    // String: it has escapes, so its contents up to that point are decoded into scratch buffer.
+
+        partial_token() { start(none); }
+
+        void start(kind_type _kind) {
+          kind = _kind;
+          scanned = 0;
+          depth = 0;
+          in_string = false;
+          decoded = false;
+        }
+      };
+    }
+
+    // Resumable tokenizer for input that arrives in chunks (e.g. from a non-blocking socket). Chunks are
+    // tokenized as they are fed, a token cut by the end of chunk (partially read string, number or literal)
+    // is carried over and completed once next chunk arrives, so chunks may be split at arbitrary bytes.
+    // Strings and skipped values that span many chunks are scanned once: only bytes of the new chunk are looked at.
+    // Callback requirements and error reporting are the same as for run_tokenizer, but structural index
+    // is not used since chunks are usually small.
+    template<typename Callback = token_callback>
+    class push_tokenizer {
+      Callback& callback;
+      std::string pending; // Unconsumed tail of previous chunks: beginning of a token that was cut short.
+      std::string scratch; // Decoded contents of strings with escapes.
+      detail::partial_token partial; // How far the token in `pending` was read.
+      bool started;
+      bool finished;
+
+      // Tokenizes given buffer, returns pointer to the first byte that wasn't consumed.
+      const char* process(const char* begin, const char* end, bool final);
+      // Continues reading the string or skipped value cut short in `pending`. Returns the number of its bytes once
+      // it's complete and reported to callback, zero if more input is needed or there was an error.
+      size_t resume(bool final);
+    public:
+      explicit push_tokenizer(Callback& _callback) : callback(_callback), pending(), scratch(), partial(), started(false), finished(false) {}
+
+      // Tokenizes as much of given chunk as possible. Returns false once tokenization is over (callback
+      // is satisfied or there was an error), further chunks are ignored then.
+      bool feed(const char* data, size_t length);
+      // Signals end of input: token carried over is completed (a number can't be told complete before that),
+      // and if callback still wants more tokens, it is an error.
+      void finish();
+      // True once tokenization is over.
+      bool done() const { return finished; }
+    };
+
+    // Virtually dispatched versions of the above, for callbacks known only by their interface.
+    void run_tokenizer(const char*, size_t, token_callback&);
+    void run_tokenizer(const std::string&, token_callback&);
     void run_tokenizer(std::istream&, token_callback&);
+
+    // Implementation details of the tokenizer. Only the token loop itself has to be visible to
+    // template code, reading of individual tokens lives in json_sa.cpp.
+    namespace detail {
+
+      // Tokenizer error - not visible to outside world, used to convey information about
+      // tokenizing failure.
+      struct tokenizer_error : public std::runtime_error {
+        tokenizer_error(const std::string reason) : std::runtime_error(reason) {}
+      };
+
+      // Thrown by token readers when token is cut short by the end of buffer. For one-shot tokenization
+      // this is an ordinary error, resumable tokenizer waits for more input instead.
+      struct incomplete_input : public tokenizer_error {
+        incomplete_input(const std::string reason) : tokenizer_error(reason) {}
+      };
+
+      // Current reading position within the input buffer. Tokenizer functions below advance `pos`
+      // past whatever they have consumed; `end` is one past the last readable byte.
+      struct cursor {
+        const char* pos;
+        const char* end;
+      };
+
+      // JSON whitespace is exactly these four characters (see json.org), unlike std::isspace which
+      // depends on locale and also accepts \v and \f.
+      inline bool is_whitespace(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+      }
+
+      inline bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+      }
+
+      // Skips JSON whitespace, returns false if nothing but whitespace is left.
+      inline bool skip_whitespace(cursor& cur) {
+        while (cur.pos != cur.end && is_whitespace(*cur.pos)) {
+          ++cur.pos;
+        }
+        return cur.pos != cur.end;
+      }
+
+      // Structural index (see json_simd.h) of the part of the buffer where the cursor is. It's built lazily, in
+      // windows of `window_bytes` as the cursor advances, so memory it takes is bounded and tokenizing that stops
+      // early costs nothing. A window always starts outside of strings (at whitespace between tokens), hence it
+      // is indexed correctly on its own.
+      struct token_index {
+        static constexpr size_t window_bytes = 64 * 1024;
+
+        const char* base;       // Positions are offsets from here
+        const char* indexed;    // and cover the buffer up to here.
+        const char* end;        // End of the buffer.
+        const uint32_t* next;   // First position that hasn't been consumed yet
+        const uint32_t* last;   // and the end of positions.
+        bool enabled;
+        std::vector<uint32_t> positions; // Positions of the current window.
+
+        // Disabled index, whitespace is skipped byte by byte.
+        token_index() : base(nullptr), indexed(nullptr), end(nullptr), next(nullptr), last(nullptr), enabled(false), positions() {}
+        token_index(const char* data, size_t length);
+        // Positions point into the index itself.
+        token_index(const token_index&)            = delete;
+        token_index& operator=(const token_index&) = delete;
+
+        // Starts indexing another buffer, memory of the previous index is reused.
+        void reset(const char* data, size_t length);
+        // Indexes the window starting at given position, which should be outside of strings.
+        void advance(const char* from);
+      };
+
+      // Moves cursor to the start of the next token, returns false if there are no tokens left.
+      // A token that immediately follows the previous one (like '1' in "[1") starts right at the cursor, otherwise
+      // cursor is at whitespace and jumps straight to the next indexed position.
+      inline bool seek_token(cursor& cur, token_index& index) {
+        if (cur.pos != cur.end && !is_whitespace(*cur.pos)) {
+          return true;
+        }
+        if (!index.enabled) {
+          return skip_whitespace(cur);
+        }
+
+        while (true) {
+          const size_t offset = cur.pos - index.base;
+          while (index.next != index.last && *index.next < offset) {
+            ++index.next;
+          }
+          if (index.next != index.last) {
+            cur.pos = index.base + *index.next;
+            return true;
+          }
+          if (index.indexed >= index.end) {
+            cur.pos = cur.end;
+            return false;
+          }
+          // Rest of the window is whitespace, so the next one starts right after it (or at cursor, if that's further).
+          if (cur.pos < index.indexed) {
+            cur.pos = index.indexed;
+          }
+          index.advance(cur.pos);
+        }
+      }
+
+      // Token readers, all of them throw tokenizer_error on malformed input. Docs in json_sa.cpp.
+      void             read_literal(cursor&, const char* literal, size_t len);
+      std::string_view read_string(cursor&, std::string& scratch);
+      double           read_number(cursor&);
+      void             skip_value(cursor&);
+
+      // Resumable flavours of read_string and skip_value: cursor is at the start of the token (at the opening quote
+      // of a string) and `state` tells where the previous scan stopped. Return false and record progress in `state`
+      // if the token doesn't end within the buffer. Otherwise cursor is moved past the token and the decoded string
+      // is stored in `result`. Scalars are not resumed, skip_partial stops at the end of buffer for them.
+      bool read_partial_string(cursor&, std::string& scratch, partial_token& state, std::string_view& result);
+      bool skip_partial(cursor&, partial_token& state);
+
+      // First characters of values that can be skipped.
+      inline bool starts_value(char c) {
+        return c == '"' || c == '{' || c == '[' || c == '-' || is_digit(c) || c == 't' || c == 'f' || c == 'n';
+      }
+
+      // Callbacks of templated tokenizer don't have to support skipping, it's only polled for if they do.
+      template<typename Callback, typename = void>
+      struct can_skip : std::false_type {};
+      template<typename Callback>
+      struct can_skip<Callback, std::void_t<decltype(std::declval<Callback&>().skip_next_value())>> : std::true_type {};
+
+      // Drains given stream into buffer, throws tokenizer_error if stream fails.
+      void read_stream(std::istream&, std::string& buffer);
+
+      // Outcome of tokenize() below.
+      enum class tokenize_result { done, failed, need_input };
+
+      // The token loop: feeds tokens starting at the cursor into callback until callback is satisfied (done),
+      // an error is reported to callback (failed) or the buffer runs out (need_input, only if `partial` is given).
+      // Buffer is final unless `partial` is given: then a token touching its end might continue in the next chunk,
+      // so the cursor is left at the start of such token instead and `partial` is set up to resume it.
+      template<typename Callback>
+      tokenize_result tokenize(cursor& cur, token_index& index, std::string& scratch, partial_token* partial, Callback& callback) {
+        while (callback.need_more_json()) {
+          if (!seek_token(cur, index)) {
+            if (partial) {
+              partial->start(partial_token::none);
+              return tokenize_result::need_input;
+            }
+            callback.json_error("Unable to proceed with reading: unexpected end of input.");
+            return tokenize_result::failed;
+          }
+
+          const char* token_start = cur.pos;
+          auto c = *cur.pos;
+          bool skipping = false;
+          try {
+            if constexpr (can_skip<Callback>::value) {
+              if (starts_value(c) && callback.skip_next_value()) {
+                skipping = true;
+                skip_value(cur);
+                if (partial && cur.pos == cur.end && c != '"' && c != '{' && c != '[') { // Scalar might continue.
+                  cur.pos = token_start;
+                  partial->start(partial_token::skipped);
+                  return tokenize_result::need_input;
+                }
+                callback.json_value_skipped();
+                continue;
+              }
+            }
+            switch (c) {
+            case 'n':
+              read_literal(cur, "null", 4);
+              callback.json_null();
+              break;
+            case 't':
+              read_literal(cur, "true", 4);
+              callback.json_boolean(true);
+              break;
+            case 'f':
+              read_literal(cur, "false", 5);
+              callback.json_boolean(false);
+              break;
+            case '{':
+              ++cur.pos;
+              callback.json_object_starts();
+              break;
+            case '}':
+              ++cur.pos;
+              callback.json_object_ends();
+              break;
+            case '[':
+              ++cur.pos;
+              callback.json_array_starts();
+              break;
+            case ']':
+              ++cur.pos;
+              callback.json_array_ends();
+              break;
+            case ':':
+              ++cur.pos;
+              callback.json_colon();
+              break;
+            case ',':
+              ++cur.pos;
+              callback.json_comma();
+              break;
+            case '"':
+              ++cur.pos; // Drop the '"'
+              callback.json_string_view(read_string(cur, scratch));
+              break;
+            default:
+              if (c == '-' || is_digit(c)) {
+                double number = read_number(cur);
+                if (partial && cur.pos == cur.end) { // More digits might follow.
+                  cur.pos = token_start;
+                  partial->start(partial_token::none);
+                  return tokenize_result::need_input;
+                }
+                callback.json_number(number);
+              } else {
+                callback.json_error("Unknown character was read: '" + std::string(1, c) + "', terminating.");
+                return tokenize_result::failed;
+              }
+            }
+          } catch (const incomplete_input& error) {
+            if (partial) {
+              cur.pos = token_start;
+              partial->start(skipping ? partial_token::skipped : c == '"' ? partial_token::string : partial_token::none);
+              return tokenize_result::need_input;
+            }
+            callback.json_error(error.what());
+            return tokenize_result::failed;
+          } catch (const tokenizer_error& error) {
+            callback.json_error(error.what());
+            return tokenize_result::failed; // Return here because we cannot rely on callback.need_more_json() to return false
+                                            // even after error and buffer could still be readable
+          }
+        }
+        return tokenize_result::done;
+      }
+    }
+
+    // Docs above.
+    struct tokenizer_buffers {
+      detail::token_index index;
+      std::string scratch; // Decoded contents of strings with escapes.
+    };
+
+    // Docs above.
+    template<typename Callback>
+    void run_tokenizer(const char* data, size_t length, Callback& callback) {
+      tokenizer_buffers buffers;
+      run_tokenizer(data, length, callback, buffers);
+    }
+
+    // Docs above.
+    template<typename Callback>
+    void run_tokenizer(const char* data, size_t length, Callback& callback, tokenizer_buffers& buffers) {
+      using namespace detail;
+
+      if (length == 0) {
+        callback.json_error("Cannot parse an empty string, top level value in JSON should be one of 'true', 'false', 'null', a string literal, an object or an array.");
+        return;
+      }
+
+      cursor cur{data, data + length};
+      buffers.index.reset(data, length);
+
+      callback.json_start();
+
+      if (tokenize(cur, buffers.index, buffers.scratch, nullptr, callback) == tokenize_result::done) {
+        // Given code structure, this call is likely unneeded, but can be used to do some finalization
+        callback.json_end();
+      }
+    }
+
+    // Docs above.
+    template<typename Callback>
+    void run_tokenizer(const std::string& source, Callback& callback) {
+      run_tokenizer(source.data(), source.size(), callback);
+    }
+
+    // Docs above.
+    template<typename Callback>
+    void run_tokenizer(std::istream& is, Callback& callback) {
+      std::string buffer;
+      try {
+        detail::read_stream(is, buffer);
+      } catch (const detail::tokenizer_error& error) {
+        callback.json_error(error.what());
+        return;
+      }
+
+      run_tokenizer(buffer.data(), buffer.size(), callback);
+    }
+
+    // Docs above.
+    template<typename Callback>
+    const char* push_tokenizer<Callback>::process(const char* begin, const char* end, bool final) {
+      detail::cursor cur{begin, end};
+      detail::token_index no_index;
+      switch (detail::tokenize(cur, no_index, scratch, final ? nullptr : &partial, callback)) {
+      case detail::tokenize_result::done:
+        finished = true;
+        callback.json_end();
+        break;
+      case detail::tokenize_result::failed:
+        finished = true;
+        break;
+      case detail::tokenize_result::need_input:
+        break;
+      }
+      return cur.pos;
+    }
+
+    // Docs above.
+    template<typename Callback>
+    size_t push_tokenizer<Callback>::resume(bool final) {
+      detail::cursor cur{pending.data(), pending.data() + pending.size()};
+      try {
+        if (partial.kind == detail::partial_token::string) {
+          std::string_view result;
+          if (!detail::read_partial_string(cur, scratch, partial, result)) {
+            if (!final) {
+              return 0;
+            }
+            throw detail::tokenizer_error("Failed to read string: unterminated string encountered.");
+          }
+          callback.json_string_view(result);
+        } else {
+          const char c = pending[0];
+          const bool scalar = c != '"' && c != '{' && c != '[';
+          if (!detail::skip_partial(cur, partial) || (scalar && !final && cur.pos == cur.end)) {
+            if (!final) {
+              return 0;
+            }
+            throw detail::tokenizer_error(c == '"' ? "Failed to skip string: unterminated string encountered." : "Failed to skip value: unterminated array or object encountered.");
+          }
+          callback.json_value_skipped();
+        }
+      } catch (const detail::tokenizer_error& error) {
+        callback.json_error(error.what());
+        finished = true;
+        return 0;
+      }
+      partial.start(detail::partial_token::none);
+      return cur.pos - pending.data();
+    }
+
+    // Docs above.
+    template<typename Callback>
+    bool push_tokenizer<Callback>::feed(const char* data, size_t length) {
+      if (finished) {
+        return false;
+      }
+      if (!started) {
+        started = true;
+        callback.json_start();
+      }
+
+      if (pending.empty()) {
+        const char* rest = process(data, data + length, false);
+        pending.assign(rest, data + length);
+      } else if (partial.kind == detail::partial_token::none) {
+        pending.append(data, length);
+        const char* rest = process(pending.data(), pending.data() + pending.size(), false);
+        pending.erase(0, rest - pending.data());
+      } else {
+        // Long string or skipped value spanning many chunks: only the new bytes are scanned.
+        pending.append(data, length);
+        if (const size_t consumed = resume(false)) {
+          const char* rest = process(pending.data() + consumed, pending.data() + pending.size(), false);
+          pending.erase(0, rest - pending.data());
+        }
+      }
+      if (finished) {
+        pending.clear();
+      }
+      return !finished;
+    }
+
+    // Docs above.
+    template<typename Callback>
+    void push_tokenizer<Callback>::finish() {
+      if (finished) {
+        return;
+      }
+      if (!started) {
+        finished = true;
+        callback.json_error("Cannot parse an empty string, top level value in JSON should be one of 'true', 'false', 'null', a string literal, an object or an array.");
+        return;
+      }
+      size_t consumed = 0;
+      if (partial.kind == detail::partial_token::none || (consumed = resume(true)) != 0) {
+        process(pending.data() + consumed, pending.data() + pending.size(), true);
+      }
+      pending.clear();
+      finished = true;
+    }
   }
 }
 
@@ -0,0 +1,508 @@
+#include "json_simd.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JSON_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// SSE2 is part of x86-64 baseline, so it doesn't need runtime checks there.
+#if defined(JSON_SIMD_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSON_SIMD_SSE2 1
+#endif
+
+// Wider kernels are compiled with per-function target attributes, which only GCC and Clang understand.
+// MSVC builds get SSE2 at most.
+#if defined(JSON_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define JSON_SIMD_DISPATCH 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace json {
+  namespace simd {
+
+    // Each bit of every mask corresponds to a byte of 64 byte block (bit 0 is the first byte).
+    struct block_masks {
+      uint64_t whitespace;
+      uint64_t operators;   // {}[]:,
+      uint64_t quotes;
+      uint64_t backslashes;
+    };
+
+    using classifier = block_masks (*)(const char*);
+
+    inline unsigned trailing_zeroes(uint64_t bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+      unsigned long index;
+      _BitScanForward64(&index, bits);
+      return index;
+#elif defined(__GNUC__) || defined(__clang__)
+      return __builtin_ctzll(bits);
+#else
+      unsigned index = 0;
+      while (!(bits & 1)) {
+        bits >>= 1;
+        ++index;
+      }
+      return index;
+#endif
+    }
+
+    // Bit i of result is xor of bits 0..i of argument, turns quote positions into "inside string" mask.
+    inline uint64_t prefix_xor(uint64_t bits) {
+      bits ^= bits << 1;
+      bits ^= bits << 2;
+      bits ^= bits << 4;
+      bits ^= bits << 8;
+      bits ^= bits << 16;
+      bits ^= bits << 32;
+      return bits;
+    }
+
+    enum char_class : uint8_t { cls_none = 0, cls_whitespace = 1, cls_operator = 2, cls_quote = 4, cls_backslash = 8 };
+
+    block_masks classify_scalar(const char* block) {
+      static const auto table = [] {
+        struct { uint8_t classes[256]; } t{};
+        for (unsigned char c : {' ', '\t', '\n', '\r'}) t.classes[c] = cls_whitespace;
+        for (unsigned char c : {'{', '}', '[', ']', ':', ','}) t.classes[c] = cls_operator;
+        t.classes[(unsigned char)'"'] = cls_quote;
+        t.classes[(unsigned char)'\\'] = cls_backslash;
+        return t;
+      }();
+
+      block_masks masks{0, 0, 0, 0};
+      for (unsigned i = 0; i < 64; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        switch (table.classes[(unsigned char)block[i]]) {
+        case cls_whitespace: masks.whitespace  |= bit; break;
+        case cls_operator:   masks.operators   |= bit; break;
+        case cls_quote:      masks.quotes      |= bit; break;
+        case cls_backslash:  masks.backslashes |= bit; break;
+        default: break;
+        }
+      }
+      return masks;
+    }
+
+    // All vector kernels below rely on the same trick for brackets: '[' and '{' (as well as ']' and '}')
+    // differ only in 0x20 bit, so or-ing it in lets us find both with one comparison.
+
+#ifdef JSON_SIMD_SSE2
+    block_masks classify_sse2(const char* block) {
+      block_masks masks{0, 0, 0, 0};
+      for (unsigned i = 0; i < 4; ++i) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        const __m128i lowered = _mm_or_si128(in, _mm_set1_epi8(0x20));
+        const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(in, _mm_set1_epi8('\t'))),
+                                        _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(in, _mm_set1_epi8('\r'))));
+        const __m128i ops = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lowered, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lowered, _mm_set1_epi8('}'))),
+                                         _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(':')), _mm_cmpeq_epi8(in, _mm_set1_epi8(','))));
+        const unsigned shift = 16 * i;
+        masks.whitespace  |= uint64_t(uint16_t(_mm_movemask_epi8(ws))) << shift;
+        masks.operators   |= uint64_t(uint16_t(_mm_movemask_epi8(ops))) << shift;
+        masks.quotes      |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8('"'))))) << shift;
+        masks.backslashes |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8('\\'))))) << shift;
+      }
+      return masks;
+    }
+#endif
+
+#ifdef JSON_SIMD_DISPATCH
+    __attribute__((target("avx2")))
+    block_masks classify_avx2(const char* block) {
+      block_masks masks{0, 0, 0, 0};
+      for (unsigned i = 0; i < 2; ++i) {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        const __m256i lowered = _mm256_or_si256(in, _mm256_set1_epi8(0x20));
+        const __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\t'))),
+                                           _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\r'))));
+        const __m256i ops = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lowered, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lowered, _mm256_set1_epi8('}'))),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8(','))));
+        const unsigned shift = 32 * i;
+        masks.whitespace  |= uint64_t(uint32_t(_mm256_movemask_epi8(ws))) << shift;
+        masks.operators   |= uint64_t(uint32_t(_mm256_movemask_epi8(ops))) << shift;
+        masks.quotes      |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('"'))))) << shift;
+        masks.backslashes |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('\\'))))) << shift;
+      }
+      return masks;
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    block_masks classify_avx512(const char* block) {
+      const __m512i in = _mm512_loadu_si512(block);
+      const __m512i lowered = _mm512_or_si512(in, _mm512_set1_epi8(0x20));
+      block_masks masks;
+      masks.whitespace  = _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8(' '))  | _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8('\t'))
+                        | _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8('\n')) | _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8('\r'));
+      masks.operators   = _mm512_cmpeq_epi8_mask(lowered, _mm512_set1_epi8('{')) | _mm512_cmpeq_epi8_mask(lowered, _mm512_set1_epi8('}'))
+                        | _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8(':'))      | _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8(','));
+      masks.quotes      = _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8('"'));
+      masks.backslashes = _mm512_cmpeq_epi8_mask(in, _mm512_set1_epi8('\\'));
+      return masks;
+    }
+#endif
+
+    using finder = const char* (*)(const char*, const char*);
+
+    const char* find_scalar(const char* begin, const char* end) {
+      while (begin != end && *begin != '"' && *begin != '\\') {
+        ++begin;
+      }
+      return begin;
+    }
+
+#ifdef JSON_SIMD_SSE2
+    const char* find_sse2(const char* begin, const char* end) {
+      const __m128i quote = _mm_set1_epi8('"');
+      const __m128i backslash = _mm_set1_epi8('\\');
+      for (; end - begin >= 16; begin += 16) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(in, quote), _mm_cmpeq_epi8(in, backslash)));
+        if (mask) {
+          return begin + trailing_zeroes(mask);
+        }
+      }
+      return find_scalar(begin, end);
+    }
+#endif
+
+#ifdef JSON_SIMD_DISPATCH
+    __attribute__((target("avx2")))
+    const char* find_avx2(const char* begin, const char* end) {
+      const __m256i quote = _mm256_set1_epi8('"');
+      const __m256i backslash = _mm256_set1_epi8('\\');
+      for (; end - begin >= 32; begin += 32) {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(in, quote), _mm256_cmpeq_epi8(in, backslash)));
+        if (mask) {
+          return begin + trailing_zeroes(mask);
+        }
+      }
+      return find_scalar(begin, end);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    const char* find_avx512(const char* begin, const char* end) {
+      const __m512i quote = _mm512_set1_epi8('"');
+      const __m512i backslash = _mm512_set1_epi8('\\');
+      for (; end - begin >= 64; begin += 64) {
+        const __m512i in = _mm512_loadu_si512(begin);
+        const uint64_t mask = _mm512_cmpeq_epi8_mask(in, quote) | _mm512_cmpeq_epi8_mask(in, backslash);
+        if (mask) {
+          return begin + trailing_zeroes(mask);
+        }
+      }
+      return find_scalar(begin, end);
+    }
+#endif
+
+    const char* find_bracket_scalar(const char* begin, const char* end) {
+      while (begin != end && *begin != '"' && (*begin | 0x20) != '{' && (*begin | 0x20) != '}') {
+        ++begin;
+      }
+      return begin;
+    }
+
+#ifdef JSON_SIMD_SSE2
+    const char* find_bracket_sse2(const char* begin, const char* end) {
+      const __m128i quote = _mm_set1_epi8('"');
+      for (; end - begin >= 16; begin += 16) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const __m128i lowered = _mm_or_si128(in, _mm_set1_epi8(0x20));
+        const __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(lowered, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lowered, _mm_set1_epi8('}')));
+        const unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(in, quote), brackets));
+        if (mask) {
+          return begin + trailing_zeroes(mask);
+        }
+      }
+      return find_bracket_scalar(begin, end);
+    }
+#endif
+
+#ifdef JSON_SIMD_DISPATCH
+    __attribute__((target("avx2")))
+    const char* find_bracket_avx2(const char* begin, const char* end) {
+      const __m256i quote = _mm256_set1_epi8('"');
+      for (; end - begin >= 32; begin += 32) {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const __m256i lowered = _mm256_or_si256(in, _mm256_set1_epi8(0x20));
+        const __m256i brackets = _mm256_or_si256(_mm256_cmpeq_epi8(lowered, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lowered, _mm256_set1_epi8('}')));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(in, quote), brackets));
+        if (mask) {
+          return begin + trailing_zeroes(mask);
+        }
+      }
+      return find_bracket_scalar(begin, end);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    const char* find_bracket_avx512(const char* begin, const char* end) {
+      const __m512i quote = _mm512_set1_epi8('"');
+      for (; end - begin >= 64; begin += 64) {
+        const __m512i in = _mm512_loadu_si512(begin);
+        const __m512i lowered = _mm512_or_si512(in, _mm512_set1_epi8(0x20));
+        const uint64_t mask = _mm512_cmpeq_epi8_mask(in, quote)
+                            | _mm512_cmpeq_epi8_mask(lowered, _mm512_set1_epi8('{')) | _mm512_cmpeq_epi8_mask(lowered, _mm512_set1_epi8('}'));
+        if (mask) {
+          return begin + trailing_zeroes(mask);
+        }
+      }
+      return find_bracket_scalar(begin, end);
+    }
+#endif
+
+    using word_finder = const uint32_t* (*)(const uint32_t*, const uint32_t*, uint32_t);
+
+    const uint32_t* find_uint32_scalar(const uint32_t* begin, const uint32_t* end, uint32_t needle) {
+      while (begin != end && *begin != needle) {
+        ++begin;
+      }
+      return begin;
+    }
+
+#ifdef JSON_SIMD_SSE2
+    const uint32_t* find_uint32_sse2(const uint32_t* begin, const uint32_t* end, uint32_t needle) {
+      const __m128i wanted = _mm_set1_epi32(int(needle));
+      for (; end - begin >= 4; begin += 4) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi32(in, wanted));
+        if (mask) {
+          return begin + trailing_zeroes(mask) / 4;
+        }
+      }
+      return find_uint32_scalar(begin, end, needle);
+    }
+#endif
+
+#ifdef JSON_SIMD_DISPATCH
+    __attribute__((target("avx2")))
+    const uint32_t* find_uint32_avx2(const uint32_t* begin, const uint32_t* end, uint32_t needle) {
+      const __m256i wanted = _mm256_set1_epi32(int(needle));
+      for (; end - begin >= 8; begin += 8) {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(in, wanted));
+        if (mask) {
+          return begin + trailing_zeroes(mask) / 4;
+        }
+      }
+#ifdef JSON_SIMD_SSE2
+      return find_uint32_sse2(begin, end, needle);
+#else
+      return find_uint32_scalar(begin, end, needle);
+#endif
+    }
+#endif
+
+    // Tracks state that crosses block boundaries.
+    struct scanner_state {
+      uint64_t escape_pending = 0; // 1 if last byte of previous block was an unescaped backslash
+      uint64_t in_string      = 0; // all ones if previous block ended inside a string
+      uint64_t after_scalar   = 0; // 1 if last byte of previous block was part of a literal/number
+    };
+
+    // Returns mask of escaped characters, i.e. the ones right after an odd-length run of backslashes.
+    // Backslashes are rare in practice, hence walking them one by one is cheap enough.
+    inline uint64_t escaped_characters(uint64_t backslashes, scanner_state& state) {
+      uint64_t escaped = 0;
+      if (state.escape_pending) {
+        escaped = 1;
+        backslashes &= ~uint64_t(1);
+      }
+      state.escape_pending = 0;
+      while (backslashes) {
+        unsigned i = trailing_zeroes(backslashes);
+        if (i == 63) {
+          state.escape_pending = 1;
+          break;
+        }
+        escaped |= uint64_t(2) << i;
+        backslashes &= ~(uint64_t(3) << i); // Escaped backslash doesn't escape anything itself.
+      }
+      return escaped;
+    }
+
+    // Computes mask of token starts of the block.
+    inline uint64_t structural_starts(const block_masks& masks, scanner_state& state) {
+      const uint64_t quotes = masks.quotes & ~escaped_characters(masks.backslashes, state);
+
+      // Opening quote and string body are set, closing quote is not.
+      const uint64_t in_string = prefix_xor(quotes) ^ state.in_string;
+      state.in_string = uint64_t(int64_t(in_string) >> 63);
+      // String body and closing quote, i.e. everything that should never become a token start.
+      const uint64_t string_tail = in_string ^ quotes;
+
+      const uint64_t scalars = ~(masks.operators | masks.whitespace);
+      const uint64_t nonquote_scalars = scalars & ~quotes;
+      const uint64_t follows_scalar = (nonquote_scalars << 1) | state.after_scalar;
+      state.after_scalar = nonquote_scalars >> 63;
+
+      return (masks.operators | (scalars & ~follows_scalar)) & ~string_tail;
+    }
+
+    void index_blocks(const char* data, size_t length, std::vector<uint32_t>& positions, classifier classify) {
+      assert(length <= UINT32_MAX);
+      scanner_state state;
+
+      auto emit = [&positions, &state](const block_masks& masks, size_t offset) {
+        uint64_t starts = structural_starts(masks, state);
+        while (starts) {
+          positions.push_back(uint32_t(offset + trailing_zeroes(starts)));
+          starts &= starts - 1;
+        }
+      };
+
+      size_t offset = 0;
+      for (; offset + 64 <= length; offset += 64) {
+        emit(classify(data + offset), offset);
+      }
+
+      if (offset < length) {
+        // Pad the tail with whitespace, which never produces any structurals.
+        char tail[64];
+        std::memset(tail, ' ', sizeof(tail));
+        std::memcpy(tail, data + offset, length - offset);
+        emit(classify(tail), offset);
+      }
+    }
+
+    classifier classifier_for(kernel k) {
+      switch (k) {
+#ifdef JSON_SIMD_SSE2
+      case kernel::sse2:   return classify_sse2;
+#endif
+#ifdef JSON_SIMD_DISPATCH
+      case kernel::avx2:   return classify_avx2;
+      case kernel::avx512: return classify_avx512;
+#endif
+      default:             return classify_scalar;
+      }
+    }
+
+    finder finder_for(kernel k) {
+      switch (k) {
+#ifdef JSON_SIMD_SSE2
+      case kernel::sse2:   return find_sse2;
+#endif
+#ifdef JSON_SIMD_DISPATCH
+      case kernel::avx2:   return find_avx2;
+      case kernel::avx512: return find_avx512;
+#endif
+      default:             return find_scalar;
+      }
+    }
+
+    finder bracket_finder_for(kernel k) {
+      switch (k) {
+#ifdef JSON_SIMD_SSE2
+      case kernel::sse2:   return find_bracket_sse2;
+#endif
+#ifdef JSON_SIMD_DISPATCH
+      case kernel::avx2:   return find_bracket_avx2;
+      case kernel::avx512: return find_bracket_avx512;
+#endif
+      default:             return find_bracket_scalar;
+      }
+    }
+
+    // Arrays searched are short, so AVX-512 doesn't pay off here.
+    word_finder word_finder_for(kernel k) {
+      switch (k) {
+#ifdef JSON_SIMD_SSE2
+      case kernel::sse2:   return find_uint32_sse2;
+#endif
+#ifdef JSON_SIMD_DISPATCH
+      case kernel::avx2:
+      case kernel::avx512: return find_uint32_avx2;
+#endif
+      default:             return find_uint32_scalar;
+      }
+    }
+
+    // Docs in header.
+    std::vector<kernel> available_kernels() {
+      std::vector<kernel> kernels{kernel::scalar};
+#ifdef JSON_SIMD_SSE2
+      kernels.push_back(kernel::sse2);
+#endif
+#ifdef JSON_SIMD_DISPATCH
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(kernel::avx2);
+      }
+      if (__builtin_cpu_supports("avx512bw")) {
+        kernels.push_back(kernel::avx512);
+      }
+#endif
+      return kernels;
+    }
+
+    // Docs in header.
+    kernel best_kernel() {
+      static const kernel best = available_kernels().back();
+      return best;
+    }
+
+    // Docs in header.
+    const char* kernel_name(kernel k) {
+      switch (k) {
+      case kernel::scalar: return "scalar";
+      case kernel::sse2:   return "sse2";
+      case kernel::avx2:   return "avx2";
+      case kernel::avx512: return "avx512";
+      }
+      return "unknown";
+    }
+
+    // Docs in header.
+    void build_structural_index(const char* data, size_t length, std::vector<uint32_t>& positions) {
+      build_structural_index(data, length, positions, best_kernel());
+    }
+
+    // Docs in header.
+    void build_structural_index(const char* data, size_t length, std::vector<uint32_t>& positions, kernel k) {
+      positions.clear();
+      // Rough guess that avoids most of reallocations on typical pretty-printed documents.
+      positions.reserve(length / 8 + 1);
+      index_blocks(data, length, positions, classifier_for(k));
+    }
+
+    // Docs in header.
+    const char* find_quote_or_backslash(const char* begin, const char* end) {
+      static const finder best = finder_for(best_kernel());
+      return best(begin, end);
+    }
+
+    // Docs in header.
+    const char* find_quote_or_backslash(const char* begin, const char* end, kernel k) {
+      return finder_for(k)(begin, end);
+    }
+
+    // Docs in header.
+    const char* find_quote_or_bracket(const char* begin, const char* end) {
+      static const finder best = bracket_finder_for(best_kernel());
+      return best(begin, end);
+    }
+
+    // Docs in header.
+    const char* find_quote_or_bracket(const char* begin, const char* end, kernel k) {
+      return bracket_finder_for(k)(begin, end);
+    }
+
+    // Docs in header.
+    const uint32_t* find_uint32(const uint32_t* begin, const uint32_t* end, uint32_t needle) {
+      static const word_finder best = word_finder_for(best_kernel());
+      return best(begin, end, needle);
+    }
+
+    // Docs in header.
+    const uint32_t* find_uint32(const uint32_t* begin, const uint32_t* end, uint32_t needle, kernel k) {
+      return word_finder_for(k)(begin, end, needle);
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef _JSON_SIMD_H_
+#define _JSON_SIMD_H_
+
+// Vectorized helpers for the tokenizer. Input is classified in 64 byte blocks with whatever
+// instruction set the CPU running the binary supports (picked once at runtime), falling back to
+// plain scalar code where nothing better is available.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace json {
+  namespace simd {
+
+    // Implementations of block classification. Not every kernel is available on every CPU
+    // (or is compiled in at all on non-x86 targets), see available_kernels().
+    enum class kernel { scalar, sse2, avx2, avx512 };
+
+    // Kernel that is used when none is requested explicitly: the best one supported by the CPU.
+    kernel best_kernel();
+    // All kernels that can run on this machine, scalar one is always present.
+    std::vector<kernel> available_kernels();
+    // Human readable kernel name (for diagnostics and tests).
+    const char* kernel_name(kernel);
+
+    // Builds structural index of given buffer: offsets of every position where a token may start,
+    // that is structural characters ({}[]:,), opening quotes of strings and first characters of
+    // literals/numbers. Characters inside strings (with escapes taken into account) are never indexed.
+    // Offsets are appended to `positions` in increasing order, hence buffer should be shorter than 4GiB.
+    void build_structural_index(const char* data, size_t length, std::vector<uint32_t>& positions);
+    // Same as above, but with explicitly chosen kernel (which must be one of available_kernels()).
+    void build_structural_index(const char* data, size_t length, std::vector<uint32_t>& positions, kernel);
+
+    // Returns pointer to the first '"' or '\\' in [begin, end) or end if there is none. This is the inner loop
+    // of string reading: everything before the returned position can be copied as is.
+    const char* find_quote_or_backslash(const char* begin, const char* end);
+    // Same as above, but with explicitly chosen kernel (which must be one of available_kernels()).
+    const char* find_quote_or_backslash(const char* begin, const char* end, kernel);
+
+    // Returns pointer to the first '"', '[', ']', '{' or '}' in [begin, end) or end if there is none. This is the inner
+    // loop of skipping a container by bracket matching: nothing but brackets and strings (which may contain
+    // brackets) has to be looked at.
+    const char* find_quote_or_bracket(const char* begin, const char* end);
+    // Same as above, but with explicitly chosen kernel (which must be one of available_kernels()).
+    const char* find_quote_or_bracket(const char* begin, const char* end, kernel);
+
+    // Returns pointer to the first element of [begin, end) equal to given one or end if there is none. This is the
+    // key search of small objects, which compares key hashes first.
+    const uint32_t* find_uint32(const uint32_t* begin, const uint32_t* end, uint32_t);
+    // Same as above, but with explicitly chosen kernel (which must be one of available_kernels()).
+    const uint32_t* find_uint32(const uint32_t* begin, const uint32_t* end, uint32_t, kernel);
+  }
+}
+
+#endif
@@ -1,7 +1,6 @@
 #include "json.h"
-#include "json_parser.h"
+#include "json_lazy.h"
 #include <iostream>
-#include <fstream>
 
 int main(int argc, char* args[]) {
   if (argc < 2) {
@@ -10,11 +9,11 @@ int main(int argc, char* args[]) {
   }
 
   try {
-    std::ifstream ifile(args[1], std::ios::in);
-    json::value input = json::parser::parse(ifile);
-    json::array_value top_level_array = input.as_array();
+    // Only `_id` of each element is needed, the rest of every element is skipped without being parsed.
+    json::lazy::document input = json::lazy::document::from_file(args[1]);
+    json::lazy::array_value top_level_array = input.root().as_array();
 
-    for (auto& it : top_level_array) {
+    for (auto it : top_level_array) {
       std::cout << it["_id"].as_string() << "\n";
     }
   } catch (const json::json_error& err) {
@@ -1,5 +1,22 @@
 #include "utils.h"
 
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define JSON_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace json {
   namespace utils {
     
@@ -9,5 +26,154 @@ namespace json {
       const std::string f = "false";
       return val ? t : f;
     }
+
+    // Empty files are never mapped (mapping of zero length is an error everywhere). Neither are pipes, devices and
+    // files like those in /proc, that have no size known upfront: they are read into the buffer till the end.
+    mapped_file::mapped_file(const std::string& path) : contents(nullptr), length(0), mapping(nullptr), buffer() {
+#if defined(JSON_HAS_MMAP)
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        throw std::runtime_error("Unable to open [file=" + path + "]: " + std::strerror(errno));
+      }
+      struct stat info;
+      if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Unable to stat [file=" + path + "]: " + std::strerror(error));
+      }
+      if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+        char chunk[64 * 1024];
+        while (true) {
+          const ssize_t count = ::read(fd, chunk, sizeof(chunk));
+          if (count < 0 && errno == EINTR) {
+            continue;
+          }
+          if (count < 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Unable to read [file=" + path + "]: " + std::strerror(error));
+          }
+          if (count == 0) {
+            break;
+          }
+          buffer.append(chunk, size_t(count));
+        }
+        contents = buffer.data();
+        length = buffer.size();
+      } else {
+        length = size_t(info.st_size);
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+          int error = errno;
+          ::close(fd);
+          throw std::runtime_error("Unable to map [file=" + path + "]: " + std::strerror(error));
+        }
+        ::madvise(address, length, MADV_SEQUENTIAL); // Only a hint, failure is harmless.
+        mapping = address;
+        contents = static_cast<const char*>(address);
+      }
+      ::close(fd); // Mapping stays valid after descriptor is closed.
+#elif defined(_WIN32)
+      HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Unable to open [file=" + path + "]: [error=" + to_string(::GetLastError()) + "]");
+      }
+      if (::GetFileType(file) != FILE_TYPE_DISK) {
+        char chunk[64 * 1024];
+        while (true) {
+          DWORD count = 0;
+          if (!::ReadFile(file, chunk, sizeof(chunk), &count, nullptr)) {
+            auto error = ::GetLastError();
+            if (error == ERROR_BROKEN_PIPE) {
+              break; // Writing end of a pipe is closed.
+            }
+            ::CloseHandle(file);
+            throw std::runtime_error("Unable to read [file=" + path + "]: [error=" + to_string(error) + "]");
+          }
+          if (count == 0) {
+            break;
+          }
+          buffer.append(chunk, count);
+        }
+        ::CloseHandle(file);
+        contents = buffer.data();
+        length = buffer.size();
+        return;
+      }
+      LARGE_INTEGER file_size;
+      if (!::GetFileSizeEx(file, &file_size)) {
+        auto error = ::GetLastError();
+        ::CloseHandle(file);
+        throw std::runtime_error("Unable to get size of [file=" + path + "]: [error=" + to_string(error) + "]");
+      }
+      length = size_t(file_size.QuadPart);
+      if (length > 0) {
+        HANDLE section = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* address = section ? ::MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        auto error = ::GetLastError();
+        if (section) {
+          ::CloseHandle(section); // View keeps the section alive.
+        }
+        if (!address) {
+          ::CloseHandle(file);
+          throw std::runtime_error("Unable to map [file=" + path + "]: [error=" + to_string(error) + "]");
+        }
+        mapping = address;
+        contents = static_cast<const char*>(address);
+      }
+      ::CloseHandle(file);
+#else
+      std::ifstream is(path, std::ios::in | std::ios::binary);
+      if (!is) {
+        throw std::runtime_error("Unable to open [file=" + path + "]");
+      }
+      buffer.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+      contents = buffer.data();
+      length = buffer.size();
+#endif
+    }
+
+    mapped_file::~mapped_file() {
+      release();
+    }
+
+    void mapped_file::release() noexcept {
+      if (mapping) {
+#if defined(JSON_HAS_MMAP)
+        ::munmap(mapping, length);
+#elif defined(_WIN32)
+        ::UnmapViewOfFile(mapping);
+#endif
+      }
+      mapping = nullptr;
+      contents = nullptr;
+      length = 0;
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept : contents(other.contents), length(other.length), mapping(other.mapping), buffer(std::move(other.buffer)) {
+      if (!mapping) {
+        contents = buffer.data();
+      }
+      other.mapping = nullptr;
+      other.contents = nullptr;
+      other.length = 0;
+    }
+
+    mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+      if (this != &other) {
+        release();
+        contents = other.contents;
+        length = other.length;
+        mapping = other.mapping;
+        buffer = std::move(other.buffer);
+        if (!mapping) {
+          contents = buffer.data();
+        }
+        other.mapping = nullptr;
+        other.contents = nullptr;
+        other.length = 0;
+      }
+      return *this;
+    }
   }
 }
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <sstream>
+#include <cstddef>
 
 namespace json {
   namespace utils {
@@ -15,6 +16,29 @@ namespace json {
 
     template<>
     std::string to_string<bool>(const bool& val);
+
+    // Read-only contents of a whole file as one contiguous buffer. Where the platform allows, regular file is
+    // memory-mapped (and kernel is told that it will be read sequentially), so that nothing is copied and pages can
+    // be dropped under memory pressure; elsewhere, and for pipes, devices and the like, it is read into memory.
+    // Throws std::runtime_error if file can't be opened or mapped.
+    class mapped_file {
+      const char* contents;
+      size_t length;
+      void* mapping;       // Platform-specific mapping handle (if any).
+      std::string buffer;  // Used when file is read instead of mapped.
+
+      void release() noexcept;
+    public:
+      explicit mapped_file(const std::string& path);
+      ~mapped_file();
+      mapped_file(const mapped_file&)            = delete;
+      mapped_file& operator=(const mapped_file&) = delete;
+      mapped_file(mapped_file&&) noexcept;
+      mapped_file& operator=(mapped_file&&) noexcept;
+
+      const char* data() const { return contents; }
+      size_t      size() const { return length; }
+    };
   }
 }
 
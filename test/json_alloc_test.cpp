@@ -0,0 +1,90 @@
+#include <boost/test/unit_test.hpp>
+
+#include "json.h"
+#include "test_resources.h"
+#include <memory_resource>
+#include <string>
+#include <utility>
+
+BOOST_AUTO_TEST_SUITE(JsonAllocations)
+
+BOOST_AUTO_TEST_CASE(BuildInPlace) {
+  counting_resource resource;
+  {
+    json::value response(json::value_type::object, &resource);
+    response.reserve(6);                                              // Object storage.
+    response.emplace("id", "a string too long to be short");          // The string.
+    response.emplace("count", 3);
+    response.emplace("a key too long to be inline", nullptr);         // The key.
+    auto& items = response.emplace("items", json::value_type::array); // The array.
+    BOOST_CHECK_EQUAL(4, resource.allocations);
+
+    items.reserve(2);                                                 // Elements.
+    auto& item = items.emplace(json::value_type::object);
+    item.emplace("name", "short");                                    // Object storage and the string.
+    BOOST_CHECK_EQUAL(7, resource.allocations);
+
+    // Existing entry is left alone.
+    BOOST_CHECK_EQUAL(3, response.emplace("count", "ignored").as_number());
+    BOOST_CHECK_EQUAL(3, response.as_object().emplace("count", json::value_type::array).as_number());
+    BOOST_CHECK_EQUAL(7, resource.allocations);
+
+    // Values built separately with the same resource are moved in. Entries were added to them with emplace, which
+    // hands out references, so copies of them copy their storage (one level deep, strings are shared).
+    json::value other(json::value_type::object, &resource);
+    other.as_object().emplace("key", "some other string");            // Object storage and the string.
+    BOOST_CHECK_EQUAL(9, resource.allocations);
+    items.push(std::move(other));
+    BOOST_CHECK(other.is_null());
+    response.insert_or_assign("first", items[0]);
+    response.as_object().insert_or_assign(json::key("last"), items.as_array()[1]);
+    BOOST_CHECK_EQUAL(11, resource.allocations);
+    BOOST_CHECK_EQUAL(R"%({"id":"a string too long to be short","count":3,"a key too long to be inline":null,)%"
+                      R"%("items":[{"name":"short"},{"key":"some other string"}],"first":{"name":"short"},)%"
+                      R"%("last":{"key":"some other string"}})%", response.serialize());
+  }
+  BOOST_CHECK_EQUAL(0, resource.outstanding);
+}
+
+BOOST_AUTO_TEST_CASE(LiteralsAndCopies) {
+  counting_resource resource;
+  std::pmr::memory_resource* previous = std::pmr::set_default_resource(&resource);
+  {
+    // The string, the array and object storage, entries are not copied.
+    json::value object{{"name", "a string too long to be short"}, {"count", 1.0}, {"list", json::value(json::value_type::array)}};
+    BOOST_CHECK_EQUAL(3, resource.allocations);
+
+    json::value copy = object;
+    json::value assigned;
+    assigned = copy;
+    json::value array(json::value_type::array);                       // The array.
+    array.reserve(2);                                                 // Elements.
+    array.push(object);
+    array.as_array().push(std::move(copy));
+    BOOST_CHECK_EQUAL(5, resource.allocations);
+    BOOST_CHECK(array[0] == assigned);
+  }
+  std::pmr::set_default_resource(previous);
+  BOOST_CHECK_EQUAL(0, resource.outstanding);
+}
+
+BOOST_AUTO_TEST_CASE(EmplaceFromOwnEntry) {
+  counting_resource resource;
+  {
+    // Initializer refers to an entry of the object, whose storage moves as entries are added.
+    json::value object(json::value_type::object, &resource);
+    object.emplace("a", "a string too long to be short");
+    object.emplace("list", json::value_type::array).push(1.0);
+    for (int i = 0; i < 64; ++i) {
+      object.emplace("k" + std::to_string(i), object["a"]);
+      object.emplace("l" + std::to_string(i), std::as_const(object).as_object()["list"]);
+    }
+    BOOST_CHECK_EQUAL(130, object.size());
+    BOOST_CHECK_EQUAL("a string too long to be short", object["k63"].as_string());
+    BOOST_CHECK_EQUAL(1, object["l63"][0].as_number());
+    BOOST_CHECK_EQUAL("a string too long to be short", object.emplace("k0", object["list"]).as_string());
+  }
+  BOOST_CHECK_EQUAL(0, resource.outstanding);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
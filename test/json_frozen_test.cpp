@@ -0,0 +1,129 @@
+#include <boost/test/unit_test.hpp>
+
+#include "json_frozen.h"
+#include "json_parser.h"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(JSONFrozen)
+
+const std::string source = R"%({
+  "id": "first",
+  "number": -12.5e1,
+  "flags": [true, false, null],
+  "escaped": "line\nbreak",
+  "nested": {"deep": [[], {}, [3]], "a": 1},
+  "": "empty key"
+})%";
+
+BOOST_AUTO_TEST_CASE(ParseFrozen) {
+  const auto doc = json::parser::parse_frozen(source);
+  const auto root = doc.root();
+
+  BOOST_CHECK_EQUAL(json::value_type::object, root.get_type());
+  BOOST_CHECK_EQUAL("first", root["id"].as_string());
+  BOOST_CHECK_EQUAL(-125, root["number"].as_number());
+  BOOST_CHECK(root["flags"][0].as_boolean());
+  BOOST_CHECK(!root["flags"][1].as_boolean());
+  BOOST_CHECK(root["flags"][2].is_null());
+  BOOST_CHECK_EQUAL("line\nbreak", root["escaped"].as_string());
+  BOOST_CHECK_EQUAL(3, root["nested"]["deep"][2][0].as_number());
+  BOOST_CHECK_EQUAL("empty key", root[""].as_string());
+
+  BOOST_CHECK(root.has("nested"));
+  BOOST_CHECK(!root.has("missing"));
+  BOOST_CHECK(!root.has("nestedx"));
+  BOOST_CHECK_THROW(root["missing"], json::json_error);
+  BOOST_CHECK_THROW(root["flags"][3], std::out_of_range);
+  BOOST_CHECK_THROW(root["id"].as_number(), json::json_error);
+  BOOST_CHECK_THROW(root[0], json::json_error);
+  BOOST_CHECK_THROW(root["id"].size(), json::json_error);
+
+  BOOST_CHECK_EQUAL(6, root.size());
+  BOOST_CHECK_EQUAL(3, root["flags"].size());
+  BOOST_CHECK(root["nested"]["deep"][0].empty());
+  BOOST_CHECK(root["nested"]["deep"][1].empty());
+
+  // Entries follow document order, even though they are looked up in key order.
+  std::stringstream ss;
+  for (const auto& entry : root.as_object()) {
+    ss << "[" << entry.first << ":" << entry.second.get_type() << "]";
+  }
+  BOOST_CHECK_EQUAL("[id:string][number:number][flags:array][escaped:string][nested:object][:string]", ss.str());
+  ss.str(std::string());
+  for (auto element : root["flags"].as_array()) {
+    ss << "[" << element.get_type() << "]";
+  }
+  BOOST_CHECK_EQUAL("[boolean][boolean][null]", ss.str());
+
+  BOOST_CHECK(json::parser::parse(source) == root.materialize());
+  BOOST_CHECK_EQUAL(json::parser::parse(source).serialize(), root.serialize());
+  BOOST_CHECK_THROW(json::parser::parse_frozen(R"%({"a": [1, 2})%"), json::json_error);
+  BOOST_CHECK_EQUAL("null", json::parser::parse_frozen("null").root().serialize());
+  BOOST_CHECK(json::frozen::document().root().is_null());
+}
+
+BOOST_AUTO_TEST_CASE(FreezeValue) {
+  json::value tree{{"b", 1.0}, {"a", "text"}, {"list", json::value(json::value_type::array)}};
+  for (int i = 0; i < 100; ++i) {
+    tree["list"].push(double(i));
+    tree["key" + std::to_string(i)] = std::string(i, 'x');
+  }
+  const json::frozen::document doc = json::freeze(tree);
+  tree["a"] = "changed"; // Document doesn't depend on the tree.
+
+  const auto root = doc.root();
+  BOOST_CHECK_EQUAL(103, root.size());
+  BOOST_CHECK_EQUAL("text", root["a"].as_string());
+  BOOST_CHECK_EQUAL(1, root["b"].as_number());
+  BOOST_CHECK_EQUAL(57, root["list"].as_array()[57].as_number());
+  for (int i = 0; i < 100; ++i) {
+    BOOST_CHECK_EQUAL(std::string(i, 'x'), root["key" + std::to_string(i)].as_string());
+  }
+  auto it = root.as_object().begin();
+  BOOST_CHECK_EQUAL("b", (*it).first);
+  BOOST_CHECK_EQUAL("a", (*++it).first);
+
+  // Copies share the tape, values stay valid as long as any copy lives.
+  json::frozen::value list = doc.root();
+  json::frozen::document survivor;
+  {
+    const json::frozen::document original = json::freeze(tree);
+    survivor = original;
+    list = original.root()["list"];
+  }
+  BOOST_CHECK_EQUAL(100, list.size());
+
+  std::vector<std::thread> readers;
+  std::vector<double> sums(4, 0);
+  for (size_t t = 0; t < sums.size(); ++t) {
+    readers.emplace_back([&doc, &sums, t]() {
+      for (auto element : doc.root()["list"].as_array()) {
+        sums[t] += element.as_number();
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  for (double sum : sums) {
+    BOOST_CHECK_EQUAL(4950, sum);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FrozenRepeatedKeys) {
+  // Later value replaces the earlier one in place of the earlier entry, just like when parsing into a tree.
+  const std::string repeated = R"%({"b": 1, "a": 2, "b": [3], "c": 4, "a": 5, "b": {"x": 6}})%";
+  const auto doc = json::parser::parse_frozen(repeated);
+  const auto root = doc.root();
+  BOOST_CHECK_EQUAL(3, root.size());
+  BOOST_CHECK_EQUAL(5, root["a"].as_number());
+  BOOST_CHECK_EQUAL(6, root["b"]["x"].as_number());
+  BOOST_CHECK_EQUAL(4, root["c"].as_number());
+  BOOST_CHECK_EQUAL(json::parser::parse(repeated).serialize(), root.serialize());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+#include <boost/test/unit_test.hpp>
+
+#include "json_lazy.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
+
+BOOST_AUTO_TEST_SUITE(JSONLazy)
+
+const std::string source = R"%( {
+  "id": "first",
+  "skipped": {"a": [1, {"b": "]}\"["}], "c": "\\\"}"},
+  "number": -12.5e1,
+  "flags": [true, false, null],
+  "escaped": "line\nbreak",
+  "nested": {"deep": [[], {}, [3]]}
+} )%";
+
+BOOST_AUTO_TEST_CASE(Scalars) {
+  json::lazy::document doc(source);
+  auto root = doc.root();
+
+  BOOST_CHECK_EQUAL(json::value_type::object, root.get_type());
+  BOOST_CHECK_EQUAL("first", root["id"].as_string());
+  BOOST_CHECK_EQUAL(-125, root["number"].as_number());
+  BOOST_CHECK(root["flags"][0].as_boolean());
+  BOOST_CHECK(!root["flags"][1].as_boolean());
+  BOOST_CHECK(root["flags"][2].is_null());
+  BOOST_CHECK_EQUAL("line\nbreak", root["escaped"].as_string());
+  BOOST_CHECK_EQUAL(3, root["nested"]["deep"][2][0].as_number());
+}
+
+BOOST_AUTO_TEST_CASE(Containers) {
+  json::lazy::document doc(source);
+  auto root = doc.root();
+
+  BOOST_CHECK(root.has("skipped"));
+  BOOST_CHECK(root.has("escaped"));
+  BOOST_CHECK(!root.has("missing"));
+  BOOST_CHECK_THROW(root["missing"], json::json_error);
+  BOOST_CHECK_THROW(root["flags"][3], std::out_of_range);
+  BOOST_CHECK_THROW(root["id"].as_number(), json::json_error);
+  BOOST_CHECK_THROW(root[0], json::json_error);
+
+  BOOST_CHECK_EQUAL(6, root.size());
+  BOOST_CHECK_EQUAL(3, root["flags"].size());
+  BOOST_CHECK(root["nested"]["deep"][0].empty());
+  BOOST_CHECK(root["nested"]["deep"][1].empty());
+  BOOST_CHECK_EQUAL(R"%({"a": [1, {"b": "]}\"["}], "c": "\\\"}"})%", root["skipped"].text());
+
+  std::stringstream ss;
+  for (const auto& entry : root.as_object()) {
+    ss << "[" << entry.first << ":" << entry.second.get_type() << "]";
+  }
+  BOOST_CHECK_EQUAL("[id:string][skipped:object][number:number][flags:array][escaped:string][nested:object]", ss.str());
+
+  ss.str(std::string());
+  for (auto element : root["flags"].as_array()) {
+    ss << "[" << element.text() << "]";
+  }
+  BOOST_CHECK_EQUAL("[true][false][null]", ss.str());
+
+  // Later duplicate key wins, just like with json::value and frozen documents.
+  json::lazy::document repeated(R"%({"a": 1, "b": 2, "a": [3]})%");
+  BOOST_CHECK_EQUAL(3, repeated.root()["a"][0].as_number());
+  BOOST_CHECK_EQUAL(2, repeated.root()["b"].as_number());
+}
+
+BOOST_AUTO_TEST_CASE(Materialize) {
+  json::lazy::document doc(source);
+  auto skipped = doc.root()["skipped"].materialize();
+
+  BOOST_CHECK_EQUAL(json::value_type::object, skipped.get_type());
+  BOOST_CHECK_EQUAL("]}\"[", skipped["a"][1]["b"].as_string());
+  BOOST_CHECK_EQUAL("\\\"}", skipped["c"].as_string());
+}
+
+BOOST_AUTO_TEST_CASE(LazyErrors) {
+  BOOST_CHECK_THROW(json::lazy::document(" \n").root(), json::json_error);
+
+  // Malformed parts are only reported when accessed.
+  json::lazy::document doc(R"%({"bad": [1, tru], "good": 1, "broken": {"x" 1}})%");
+  auto root = doc.root();
+  BOOST_CHECK_EQUAL(1, root["good"].as_number());
+  BOOST_CHECK_EQUAL(1, root["bad"][0].as_number());
+  BOOST_CHECK_THROW(root["bad"][1].as_boolean(), json::json_error);
+  BOOST_CHECK_THROW(root["broken"]["x"], json::json_error);
+  BOOST_CHECK_THROW(root["missing"], json::json_error);
+
+  // Key lookup walks the whole object (a later entry might repeat the key), so it needs the object to be closed.
+  json::lazy::document open(R"%({"good": 1, "open": [1, 2)%");
+  BOOST_CHECK_EQUAL(1, (*open.root().as_object().begin()).second.as_number());
+  BOOST_CHECK_THROW(open.root()["good"], json::json_error);
+
+  BOOST_CHECK_THROW(json::lazy::value("12x").as_number(), json::json_error);
+
+  // Containers cut right where an entry should be never read past the end of input.
+  BOOST_CHECK_THROW(json::lazy::value("[").as_array().begin(), json::json_error);
+  BOOST_CHECK_THROW(json::lazy::value("[").size(), json::json_error);
+  BOOST_CHECK_THROW(json::lazy::value("[1,")[1], json::json_error);
+  BOOST_CHECK_THROW(json::lazy::value("[1, ").size(), json::json_error);
+  BOOST_CHECK_THROW(json::lazy::value("{").has("a"), json::json_error);
+  BOOST_CHECK_THROW(json::lazy::value("{\"a\":")["a"], json::json_error);
+  BOOST_CHECK_THROW(json::lazy::value("{\"a\": 1, ").size(), json::json_error);
+}
+
+BOOST_AUTO_TEST_CASE(LazyFile) {
+  const auto path = (std::filesystem::temp_directory_path() / "json_lazy_test_file.json").string();
+  {
+    std::ofstream os(path);
+    os << "[{\"_id\": \"a\", \"tags\": [\"x\"]}, {\"_id\": \"b\"}]\n";
+  }
+
+  {
+    auto doc = json::lazy::document::from_file(path);
+    auto moved = std::move(doc);
+    std::string ids;
+    for (auto element : moved.root().as_array()) {
+      ids += element["_id"].as_string();
+    }
+    BOOST_CHECK_EQUAL("ab", ids);
+  }
+  std::remove(path.c_str());
+
+  BOOST_CHECK_THROW(json::lazy::document::from_file(path), json::json_error);
+
+  // Truncated array that ends right at a page boundary of the mapping.
+  {
+    std::ofstream os(path);
+    os << std::string(4095, ' ') << "[";
+  }
+  {
+    auto doc = json::lazy::document::from_file(path);
+    BOOST_CHECK_EQUAL(json::value_type::array, doc.root().get_type());
+    BOOST_CHECK_THROW(doc.root().as_array().begin(), json::json_error);
+  }
+  std::remove(path.c_str());
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+BOOST_AUTO_TEST_CASE(LazyFifo) {
+  const auto path = (std::filesystem::temp_directory_path() / "json_lazy_test_fifo").string();
+  std::remove(path.c_str());
+  BOOST_REQUIRE_EQUAL(0, ::mkfifo(path.c_str(), 0600));
+  std::thread writer([&path]() {
+    std::ofstream os(path);
+    os << "[{\"_id\": \"a\"}, {\"_id\": \"b\"}]\n";
+  });
+  auto doc = json::lazy::document::from_file(path);
+  writer.join();
+  std::remove(path.c_str());
+
+  std::string ids;
+  for (auto element : doc.root().as_array()) {
+    ids += element["_id"].as_string();
+  }
+  BOOST_CHECK_EQUAL("ab", ids);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,7 +2,21 @@
 
 #include "json.h"
 #include "json_parser.h"
+#include "test_resources.h"
 #include <memory>
+#include <memory_resource>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
 
 BOOST_AUTO_TEST_SUITE(JSONParser)
 
@@ -20,6 +34,13 @@ BOOST_AUTO_TEST_CASE(ParseAndWriteString) {
   BOOST_CHECK_EQUAL("\"Some string\"", node.serialize());
 }
 
+BOOST_AUTO_TEST_CASE(ParseAndWriteEscapedString) {
+  auto node = json::parser::parse(R"%("quote \" backslash \\ newline \n")%");
+
+  BOOST_CHECK_EQUAL("quote \" backslash \\ newline \n", node.as_string());
+  BOOST_CHECK_EQUAL(R"%("quote \" backslash \\ newline \n")%", node.serialize());
+}
+
 BOOST_AUTO_TEST_CASE(ParseAndWriteNumber) {
   auto node = json::parser::parse("8.128");
 
@@ -28,6 +49,31 @@ BOOST_AUTO_TEST_CASE(ParseAndWriteNumber) {
   BOOST_CHECK_EQUAL("8.128", node.serialize());
 }
 
+BOOST_AUTO_TEST_CASE(ParseNumbersExactly) {
+  BOOST_CHECK_EQUAL(0.0, json::parser::parse("0").as_number());
+  BOOST_CHECK_EQUAL(37.0, json::parser::parse("37").as_number());
+  BOOST_CHECK_EQUAL(-12.5, json::parser::parse("-1.25e1").as_number());
+  BOOST_CHECK_EQUAL(0.1, json::parser::parse("0.1").as_number());
+  BOOST_CHECK_EQUAL(1e23, json::parser::parse("1e23").as_number());
+  BOOST_CHECK_EQUAL(1.7976931348623157e308, json::parser::parse("1.7976931348623157e308").as_number());
+  BOOST_CHECK_EQUAL(4.9406564584124654e-324, json::parser::parse("4.9406564584124654e-324").as_number());
+  BOOST_CHECK_EQUAL(0.0, json::parser::parse("1e-400").as_number());
+  BOOST_CHECK_EQUAL(9007199254740992.0, json::parser::parse("9007199254740993").as_number()); // Halfway, ties to even.
+  BOOST_CHECK_EQUAL(18446744073709551615.0, json::parser::parse("18446744073709551615").as_number());
+  BOOST_CHECK_EQUAL(123456789012345678901234567890.0, json::parser::parse("123456789012345678901234567890").as_number());
+  BOOST_CHECK_EQUAL(2.2250738585072011e-308, json::parser::parse("2.2250738585072011e-308").as_number());
+  BOOST_CHECK_EQUAL(0.30000000000000004, json::parser::parse("0.3000000000000000444089209850062616169452667236328125").as_number());
+}
+
+BOOST_AUTO_TEST_CASE(ParseNumberFailures) {
+  BOOST_CHECK_THROW(json::parser::parse("01"), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("-"), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("1."), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("1e+"), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("1e400"), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse(".5"), json::json_error);
+}
+
 BOOST_AUTO_TEST_CASE(ParseAndWriteBoolean) {
   auto true_node = json::parser::parse("true");
   auto false_node = json::parser::parse("false");
@@ -97,6 +143,19 @@ BOOST_AUTO_TEST_CASE(ParseAndWriteArrayObject) {
   BOOST_CHECK_EQUAL("[1,{\"key\":2}]", node.serialize());
 }
 
+BOOST_AUTO_TEST_CASE(ParseNestedContainers) {
+  const std::string source = R"%({"a": [1, [2, {}], {"b": [], "c": {"d": [3]}}], "e": {"f": null}, "g": []})%";
+  BOOST_CHECK_EQUAL(json::parser::parse(source).serialize().size(), source.size() - 13); // Only spaces are dropped.
+
+  auto node = json::parser::parse(source);
+  BOOST_CHECK_EQUAL(3, node["a"][2]["c"]["d"][0].as_number());
+  BOOST_CHECK_EQUAL(0, node["a"][1][1].size());
+  BOOST_CHECK(node["e"]["f"].is_null());
+
+  // Later duplicate key wins.
+  BOOST_CHECK_EQUAL(2, json::parser::parse(R"%({"k": 1, "k": 2})%")["k"].as_number());
+}
+
 BOOST_AUTO_TEST_CASE(ParseFailures) {
   BOOST_CHECK_THROW(json::parser::parse("{,}"), json::json_error);
   BOOST_CHECK_THROW(json::parser::parse("{\"key\":1,}"), json::json_error);
@@ -118,4 +177,370 @@ BOOST_AUTO_TEST_CASE(ParseFailures) {
 } 
 
 
+BOOST_AUTO_TEST_CASE(PushParse) {
+  const std::string source = R"%({"key": [1, 2.5, "str\nng", true, null], "other": {"nested": -3e2}})%";
+  const auto expected = json::parser::parse(source).serialize();
+
+  for (size_t split = 0; split <= source.size(); ++split) {
+    json::parser::push_parser parser;
+    BOOST_CHECK_EQUAL(split < source.size(), parser.feed(source.substr(0, split)));
+    parser.feed(source.substr(split));
+    BOOST_CHECK_EQUAL(expected, parser.finish().serialize());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PushParseFailures) {
+  json::parser::push_parser truncated;
+  truncated.feed("[1, 2");
+  BOOST_CHECK_THROW(truncated.finish(), json::json_error);
+
+  json::parser::push_parser malformed;
+  BOOST_CHECK_THROW(malformed.feed("[1 2]"), json::json_error);
+
+  json::parser::push_parser empty;
+  BOOST_CHECK_THROW(empty.finish(), json::json_error);
+}
+
+BOOST_AUTO_TEST_CASE(ParseFile) {
+  const auto path = (std::filesystem::temp_directory_path() / "json_parse_test_file.json").string();
+  {
+    std::ofstream os(path);
+    os << "[{\"_id\": \"a\"}, {\"_id\": \"b\"}]\n";
+  }
+
+  auto node = json::parser::parse_file(path);
+  std::remove(path.c_str());
+
+  BOOST_CHECK_EQUAL(2, node.size());
+  BOOST_CHECK_EQUAL("b", node[1]["_id"].as_string());
+  BOOST_CHECK_THROW(json::parser::parse_file(path), json::json_error);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+BOOST_AUTO_TEST_CASE(ParseFifo) {
+  // Pipe has no size upfront, so it's read till the end instead of being mapped.
+  const auto path = (std::filesystem::temp_directory_path() / "json_parse_test_fifo").string();
+  std::remove(path.c_str());
+  BOOST_REQUIRE_EQUAL(0, ::mkfifo(path.c_str(), 0600));
+  std::thread writer([&path]() {
+    std::ofstream os(path);
+    os << "[{\"_id\": \"a\"}, " << std::string(100000, ' ') << "{\"_id\": \"b\"}]\n";
+  });
+  auto node = json::parser::parse_file(path);
+  writer.join();
+  std::remove(path.c_str());
+
+  BOOST_CHECK_EQUAL(2, node.size());
+  BOOST_CHECK_EQUAL("b", node[1]["_id"].as_string());
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(ParseParallel) {
+  const std::string source = R"%([1, "two", {"three": [3, 3.5]}, [], null, true, -7e1, {"k": "v,]"}, [[8]], "ten"])%";
+  const auto expected = json::parser::parse(source).serialize();
+
+  for (unsigned threads = 1; threads <= 12; ++threads) {
+    BOOST_CHECK_EQUAL(expected, json::parser::parse_parallel(source, threads).serialize());
+  }
+  BOOST_CHECK_EQUAL(expected, json::parser::parse_parallel(source).serialize());
+  BOOST_CHECK_EQUAL("{\"key\":[1,2]}", json::parser::parse_parallel("{\"key\": [1, 2]}", 4).serialize());
+  BOOST_CHECK_EQUAL("[]", json::parser::parse_parallel("[ ]", 4).serialize());
+  BOOST_CHECK_EQUAL("[1,2]", json::parser::parse_parallel("[1,2]", 4).serialize());
+
+  // Elements are located window by window: strings longer than a window (looking like separators inside) and
+  // whitespace runs must not confuse that.
+  std::string large = std::string(200000, ' ') + "[";
+  for (size_t i = 0; i < 30000; ++i) {
+    large += i % 10000 == 5 ? "\"" + std::string(150000, ',') + "]\"," : "{\"k\": [" + std::to_string(i) + "]},";
+  }
+  large += "\"" + std::string(70000, '[') + "\"]";
+  const auto large_expected = json::parser::parse(large).serialize();
+  for (unsigned threads = 2; threads <= 5; ++threads) {
+    BOOST_CHECK_EQUAL(large_expected, json::parser::parse_parallel(large, threads).serialize());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParseParallelFailures) {
+  for (unsigned threads = 2; threads <= 4; ++threads) {
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[1,]", threads), json::json_error);
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[,1]", threads), json::json_error);
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[1,,2]", threads), json::json_error);
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[1,2 3,4]", threads), json::json_error);
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[1,{\"a\":2},3}", threads), json::json_error);
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[1,2,[3", threads), json::json_error);
+    BOOST_CHECK_THROW(json::parser::parse_parallel("[1,tru,3]", threads), json::json_error);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParseRecords) {
+  auto serialize = [](const std::vector<json::value>& values) {
+    std::string result;
+    for (const auto& value : values) {
+      result += value.serialize() + ";";
+    }
+    return result;
+  };
+
+  BOOST_CHECK_EQUAL("{\"a\":1};[2,3];\"four\";5;null;", serialize(json::parser::parse_records("{\"a\": 1}\n[2, 3]\n\"four\"\r\n5\nnull\n")));
+  BOOST_CHECK_EQUAL("1;\"two\";[3];true;", serialize(json::parser::parse_records("\x1E" "1\n\x1E\"two\"\n\x1E[3]\n\x1E\x1E true\n")));
+  BOOST_CHECK_EQUAL("1;2;[3];{};\"a\";\"b\";", serialize(json::parser::parse_records("1 2[3]{}\"a\"\"b\"")));
+  BOOST_CHECK_EQUAL("{\"a\":[1,2]};", serialize(json::parser::parse_records("{\n  \"a\": [\n    1,\n    2\n  ]\n}\n")));
+  BOOST_CHECK(json::parser::parse_records(" \n\n ").empty());
+
+  // Long enough to span several blocks when read from stream.
+  std::string lines;
+  const std::string text(400, 't');
+  for (int i = 0; i < 3000; ++i) {
+    lines += "{\"id\": " + std::to_string(i) + ", \"tags\": [\"x\", \"y\"], \"text\": \"" + text + "\\n\"}\n";
+  }
+  const auto expected = serialize(json::parser::parse_records(lines, 1));
+  for (unsigned threads : {2u, 3u, 8u}) {
+    BOOST_CHECK_EQUAL(expected, serialize(json::parser::parse_records(lines, threads)));
+
+    std::vector<json::value> values;
+    std::istringstream is(lines);
+    json::parser::parse_records(is, [&values](json::value&& value) { values.push_back(std::move(value)); }, threads);
+    BOOST_CHECK_EQUAL(expected, serialize(values));
+
+    std::vector<int> ids;
+    json::parser::parse_records(lines, [&ids](json::value&& value) { ids.push_back(int(value["id"].as_number())); }, threads, json::parser::delivery::unordered);
+    std::sort(ids.begin(), ids.end());
+    BOOST_CHECK_EQUAL(3000, ids.size());
+    BOOST_CHECK(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParseRecordsFailures) {
+  for (unsigned threads = 1; threads <= 4; ++threads) {
+    for (const char* source : {"1\n2x\n3", "1\n[2,\n", "1\n]\n", "[1]\n\"open", "{\"a\":\x1E 1}", "truefalse"}) {
+      BOOST_CHECK_THROW(json::parser::parse_records(source, threads), json::json_error);
+    }
+
+    std::vector<json::value> values;
+    auto collect = [&values](json::value&& value) { values.push_back(std::move(value)); };
+    BOOST_CHECK_THROW(json::parser::parse_records("1\n2\n[3\n}\n5\n", collect, threads), json::json_error);
+    BOOST_CHECK_EQUAL(2, values.size());
+
+    auto reject = [](json::value&& value) { if (value.as_number() == 2) throw std::logic_error("rejected"); };
+    BOOST_CHECK_THROW(json::parser::parse_records("1\n2\n3\n", reject, threads), std::logic_error);
+  }
+}
+
+// Stream of a malformed record followed by `total` bytes of valid ones, made up as they are read.
+struct broken_records_buffer : std::streambuf {
+  std::string chunk;
+  size_t remaining;
+  size_t served;
+
+  broken_records_buffer(const char* broken, size_t total) : chunk(broken), remaining(total), served(0) {
+    setg(chunk.data(), chunk.data(), chunk.data() + chunk.size());
+    served = chunk.size();
+  }
+
+  int_type underflow() override {
+    if (remaining == 0) {
+      return traits_type::eof();
+    }
+    chunk.clear();
+    while (chunk.size() < 64 * 1024) {
+      chunk += "{\"a\": [1, 2, 3]}\n";
+    }
+    chunk.resize(std::min(chunk.size(), remaining));
+    remaining -= chunk.size();
+    served += chunk.size();
+    setg(chunk.data(), chunk.data(), chunk.data() + chunk.size());
+    return traits_type::to_int_type(chunk[0]);
+  }
+};
+
+BOOST_AUTO_TEST_CASE(ParseRecordsStopsEarly) {
+  constexpr size_t total = 64 * 1024 * 1024;
+  // Unclosed container is cut by the splitter, a closed one fails while parsing.
+  for (const char* broken : {"{bad\n", "[tru]\n"}) {
+    for (unsigned threads : {1u, 4u}) {
+      broken_records_buffer buffer(broken, total);
+      std::istream is(&buffer);
+      size_t delivered = 0;
+      BOOST_CHECK_THROW(json::parser::parse_records(is, [&delivered](json::value&&) { ++delivered; }, threads), json::json_error);
+      BOOST_CHECK_EQUAL(0, delivered);
+      // Producer stops within a few blocks of the error instead of reading the whole stream.
+      BOOST_CHECK_LT(buffer.served, 8 * 1024 * 1024);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParseWithProjection) {
+  const std::string source = R"%([
+    {"_id": "a", "name": "A", "friends": [{"id": 1, "name": "X"}, {"id": 2, "name": "Y"}], "tags": ["t"]},
+    {"_id": "b", "friends": [], "extra": {"deep": [1, 2, 3]}},
+    {"name": "C", "friends": [{"name": "Z"}]},
+    "scalar"
+  ])%";
+
+  auto ids = json::parser::parse(source, {"/*/_id"});
+  BOOST_CHECK_EQUAL(R"%([{"_id":"a"},{"_id":"b"},{}])%", ids.serialize());
+
+  auto names = json::parser::parse(source, {"/*/friends/*/name", "/0/tags"});
+  BOOST_CHECK_EQUAL(3, names.size());
+  BOOST_CHECK_EQUAL(2, names[0].size());
+  BOOST_CHECK_EQUAL(R"%([{"name":"X"},{"name":"Y"}])%", names[0]["friends"].serialize());
+  BOOST_CHECK_EQUAL(R"%(["t"])%", names[0]["tags"].serialize());
+  BOOST_CHECK_EQUAL(R"%({"friends":[]})%", names[1].serialize());
+  BOOST_CHECK_EQUAL(R"%({"friends":[{"name":"Z"}]})%", names[2].serialize());
+
+  auto second = json::parser::parse(source, {"/1"});
+  BOOST_CHECK_EQUAL(1, second.size());
+  BOOST_CHECK_EQUAL(3, second[0]["extra"]["deep"].size());
+
+  BOOST_CHECK_EQUAL(json::parser::parse(source).serialize(), json::parser::parse(source, {""}).serialize());
+  BOOST_CHECK_EQUAL("[]", json::parser::parse(source, {}).serialize());
+  auto escaped = json::parser::parse(R"%({"a/b": 1, "c~": 2, "d": 3})%", {"/a~1b", "/c~0"});
+  BOOST_CHECK_EQUAL(2, escaped.size());
+  BOOST_CHECK_EQUAL(1, escaped["a/b"].as_number());
+  BOOST_CHECK_EQUAL(2, escaped["c~"].as_number());
+  BOOST_CHECK(json::parser::parse("1", {"/a"}).is_null());
+}
+
+BOOST_AUTO_TEST_CASE(ParseWithProjectionFailures) {
+  BOOST_CHECK_THROW(json::parser::projection({"a"}), json::json_error);
+  BOOST_CHECK_THROW(json::parser::projection({"/a~2"}), json::json_error);
+
+  const json::parser::projection ids{"/*/_id"};
+  BOOST_CHECK_THROW(json::parser::parse("[{\"_id\": 1,}]", ids), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("[{\"_id\" 1}]", ids), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("[{\"x\": 1]", ids), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("[{\"x\": [1}]", ids), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("[1 2]", ids), json::json_error);
+  BOOST_CHECK_THROW(json::parser::parse("", ids), json::json_error);
+}
+
+BOOST_AUTO_TEST_CASE(ParseIntoDocument) {
+  // Whole tree has to fit into the buffer, otherwise null resource throws.
+  std::vector<char> buffer(64 * 1024);
+  json::document doc(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+  auto& root = json::parser::parse(R"%([{"_id": "first", "tags": ["a", "b"], "text": "long enough to leave small string buffer"}, 12.5, null])%", doc);
+  BOOST_CHECK(&root == &doc.root());
+  BOOST_CHECK_EQUAL(3, root.size());
+  BOOST_CHECK_EQUAL("first", root[0]["_id"].as_string());
+  BOOST_CHECK_EQUAL("b", root[0]["tags"][1].as_string());
+  BOOST_CHECK_EQUAL(12.5, root[1].as_number());
+  BOOST_CHECK(root[0]["text"].get_resource() == doc.resource());
+
+  // Reparsing releases the arena first, so it can go on forever.
+  for (int i = 0; i < 1000; ++i) {
+    BOOST_CHECK_EQUAL(i, json::parser::parse("{\"i\": " + std::to_string(i) + ", \"pad\": \"" + std::string(200, 'x') + "\"}", doc)["i"].as_number());
+  }
+  BOOST_CHECK_EQUAL("\"str\"", json::parser::parse("\"str\"", doc).serialize());
+  BOOST_CHECK_THROW(json::parser::parse("[1, 2", doc), json::json_error);
+}
+
+BOOST_AUTO_TEST_CASE(ParseInternsKeys) {
+  json::document doc;
+  auto& root = json::parser::parse(R"%([{"_id": 1, "name": "a"}, {"name": "b", "_id": 2, "_id": 3}, {"other": {"_id": 4}}])%", doc);
+  BOOST_CHECK_EQUAL(3, root[1]["_id"].as_number());
+  BOOST_CHECK_EQUAL(2, root[1].size());
+
+  // Every occurrence of a key is the same text in the arena.
+  const auto id = doc.intern("_id");
+  BOOST_CHECK(id.text().data() == doc.intern(std::string("_id")).text().data());
+  BOOST_CHECK(id.text().data() != doc.intern("name").text().data());
+  std::vector<const char*> ids;
+  for (auto* object : {&root[0], &root[1], &root[2]["other"]}) {
+    for (auto it = object->as_object().begin(); it != object->as_object().end(); ++it) {
+      if ((*it).first == "_id") {
+        ids.push_back((*it).first.data());
+      }
+    }
+  }
+  BOOST_CHECK_EQUAL(3, ids.size());
+  for (auto* text : ids) {
+    BOOST_CHECK(text == id.text().data());
+  }
+
+  // Keys added later are not interned, but found all the same.
+  root[0]["_id"] = 5.0;
+  root[0]["added"] = true;
+  BOOST_CHECK_EQUAL(3, root[0].size());
+  BOOST_CHECK(root[0]["added"].as_boolean());
+  BOOST_CHECK_EQUAL(R"%({"_id":5,"name":"a","added":true})%", root[0].serialize());
+
+  // Short strings are shared as well, writing one of them leaves the others alone.
+  auto& colors = json::parser::parse(R"%(["green", "blue", "green", "a string too long to be shared"])%", doc);
+  BOOST_CHECK_EQUAL("green", colors[2].as_string());
+  colors[0] = "red";
+  colors[1] = "";
+  BOOST_CHECK_EQUAL(R"%(["red","","green","a string too long to be shared"])%", colors.serialize());
+
+  // Table starts over together with the arena.
+  json::parser::parse("{\"_id\": 1}", doc);
+  BOOST_CHECK_EQUAL(1, doc.root()["_id"].as_number());
+}
+
+namespace {
+
+std::string message(int id, const std::string& name, const std::string& tags) {
+  return "{\"id\": " + std::to_string(id) + ", \"name\": \"" + name + "\", \"tags\": [" + tags + "], \"nested\": {\"flag\": true}}";
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(ParseWithContext) {
+  json::parser::context context;
+  for (int i = 0; i < 3; ++i) {
+    auto node = context.parse(message(i, "name", "\"a\", \"b\""));
+    BOOST_CHECK_EQUAL(i, node["id"].as_number());
+    BOOST_CHECK_EQUAL("b", node["tags"][1].as_string());
+    BOOST_CHECK_THROW(context.parse("[1, "), json::json_error);
+  }
+
+  counting_resource resource;
+  json::value target(json::value_type::null, &resource);
+  context.parse_into(message(0, std::string(100, 'x'), "\"long enough to be allocated\", \"b\""), target);
+  const auto* name = &target["name"];
+  const auto* tag = &target["tags"][0];
+
+  // Similarly shaped messages are written over the same nodes without allocating anything.
+  const size_t allocations = resource.allocations;
+  for (int i = 1; i < 100; ++i) {
+    auto& result = context.parse_into(message(i, std::string(100 - i % 10, 'y'), "\"tag " + std::to_string(i) + "\", \"b\""), target);
+    BOOST_CHECK(&result == &target);
+  }
+  BOOST_CHECK_EQUAL(allocations, resource.allocations);
+  BOOST_CHECK_EQUAL(99, target["id"].as_number());
+  BOOST_CHECK_EQUAL("tag 99", target["tags"][0].as_string());
+  BOOST_CHECK(name == &target["name"]);
+  BOOST_CHECK(tag == &target["tags"][0]);
+  BOOST_CHECK(target["nested"].get_resource() == &resource);
+
+  // Missing entries and elements are removed, types are replaced.
+  context.parse_into(R"%({"id": "str", "tags": [{"x": 1}], "added": [], "nested": {}, "nested": null})%", target);
+  BOOST_CHECK_EQUAL(4, target.size());
+  BOOST_CHECK(!target.has("name"));
+  BOOST_CHECK_EQUAL("str", target["id"].as_string());
+  BOOST_CHECK_EQUAL(1, target["tags"].size());
+  BOOST_CHECK_EQUAL(1, target["tags"][0]["x"].as_number());
+  BOOST_CHECK(target["added"].empty());
+  BOOST_CHECK(target["nested"].is_null());
+
+  context.parse_into("[1, 2]", target);
+  BOOST_CHECK_EQUAL("[1,2]", target.serialize());
+  BOOST_CHECK_THROW(context.parse_into("[1, 2", target), json::json_error);
+  BOOST_CHECK_EQUAL("\"s\"", context.parse_into("\"s\"", target).serialize());
+
+  // Entries of a large (hence indexed) object arrive in reverse order, each of them is swapped into place.
+  std::string forward = "{", reverse = "{";
+  for (int i = 0; i < 200; ++i) {
+    forward += (i ? ", \"k" : "\"k") + std::to_string(i) + "\": " + std::to_string(i);
+    reverse += (i ? ", \"k" : "\"k") + std::to_string(199 - i) + "\": 0";
+  }
+  context.parse_into(reverse + "}", target);
+  context.parse_into(forward + "}", target);
+  BOOST_CHECK(context.parse(forward + "}") == target);
+  for (int i = 0; i < 200; ++i) {
+    BOOST_CHECK_EQUAL(i, target["k" + std::to_string(i)].as_number());
+    BOOST_CHECK_EQUAL("k" + std::to_string(i), std::next(std::as_const(target).as_object().begin(), i)->first);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
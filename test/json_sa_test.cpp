@@ -1,6 +1,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include "json_sa.h"
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -103,7 +105,34 @@ BOOST_AUTO_TEST_CASE(ReadString) {
 
   run_tokenizer(R"%(["ololo-trololo\"somestuff"])%", callback);
 
-  BOOST_CHECK_EQUAL(R"%([start][arr::start][string:ololo-trololo\"somestuff][arr::end][end])%", callback.buffer.str());
+  BOOST_CHECK_EQUAL(R"%([start][arr::start][string:ololo-trololo"somestuff][arr::end][end])%", callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadStringEscapes) {
+  test_callback callback(stopper::array_end);
+
+  run_tokenizer(R"%(["\\ \/ \b\f\n\r\t \u0041\u00e9\u20AC \ud83d\ude00"])%", callback);
+
+  BOOST_CHECK_EQUAL("[start][arr::start][string:\\ / \b\f\n\r\t A\xC3\xA9\xE2\x82\xAC \xF0\x9F\x98\x80][arr::end][end]", callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadLongString) {
+  test_callback callback(stopper::array_end);
+  std::string body(1000, 'x');
+
+  run_tokenizer("[\"" + body + "\\n" + body + "\"]", callback);
+
+  BOOST_CHECK_EQUAL("[start][arr::start][string:" + body + "\n" + body + "][arr::end][end]", callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadStringEscapeFailures) {
+  for (auto source : {R"%(["\x"])%", R"%(["\u12"])%", R"%(["\u12G4"])%", R"%(["\ud83d"])%", R"%(["\ud83d\u0041"])%", R"%(["\ude00"])%", R"%(["abc\)%"}) {
+    test_callback callback(stopper::array_end);
+
+    run_tokenizer(source, callback);
+
+    BOOST_CHECK_EQUAL("[start][arr::start][error]", callback.buffer.str());
+  }
 }
 
 BOOST_AUTO_TEST_CASE(ReadNumberFail) {
@@ -119,7 +148,7 @@ BOOST_AUTO_TEST_CASE(ReadArray) {
 
   run_tokenizer(R"%([null,   "ololo-trololo\"somestuff", true])%", callback);
 
-  BOOST_CHECK_EQUAL(R"%([start][arr::start][null][comma][string:ololo-trololo\"somestuff][comma][boolean:true][arr::end][end])%", callback.buffer.str());
+  BOOST_CHECK_EQUAL(R"%([start][arr::start][null][comma][string:ololo-trololo"somestuff][comma][boolean:true][arr::end][end])%", callback.buffer.str());
 }
 
 BOOST_AUTO_TEST_CASE(ReadMangled) {
@@ -130,4 +159,257 @@ BOOST_AUTO_TEST_CASE(ReadMangled) {
   BOOST_CHECK_EQUAL("[start][error]", callback.buffer.str());
 }
 
+BOOST_AUTO_TEST_CASE(ReadBuffer) {
+  test_callback callback(stopper::array_end);
+  const char buffer[] = "[1, true]garbage that is never looked at";
+
+  json::simple::run_tokenizer(buffer, 9, callback);
+
+  BOOST_CHECK_EQUAL("[start][arr::start][number:1][comma][boolean:true][arr::end][end]", callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadStream) {
+  test_callback callback(stopper::array_end);
+  std::stringstream is(" [ null ,\n\t-12.5e1 ] ");
+
+  json::simple::run_tokenizer(is, callback);
+
+  BOOST_CHECK_EQUAL("[start][arr::start][null][comma][number:-125][arr::end][end]", callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadTruncated) {
+  test_callback callback(stopper::array_end);
+
+  run_tokenizer("[1,", callback);
+
+  BOOST_CHECK_EQUAL("[start][arr::start][number:1][comma][error]", callback.buffer.str());
+}
+
+// Records whether strings were handed out as views into the source buffer.
+struct view_callback : public json::simple::token_callback {
+  const std::string& source;
+  std::stringstream buffer;
+
+  view_callback(const std::string& _source) : source(_source) {}
+
+  void json_string_view(std::string_view str) override {
+    bool in_source = str.data() >= source.data() && str.data() + str.size() <= source.data() + source.size();
+    buffer << "[" << (in_source ? "view:" : "copy:") << str << "]";
+  }
+
+  bool need_more_json() override {
+    return true;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(ReadStringViews) {
+  const std::string source = R"%(["plain", "esc\"aped", ""])%";
+  view_callback callback(source);
+
+  run_tokenizer(source, callback);
+
+  BOOST_CHECK_EQUAL(R"%([view:plain][copy:esc"aped][view:])%", callback.buffer.str());
+}
+
+// Duck-typed callback - not derived from token_callback at all, only usable with templated tokenizer.
+struct counting_callback {
+  size_t tokens = 0;
+  int depth = 0;
+  bool failed = false;
+
+  void json_start() {}
+  void json_end() {}
+  void json_string_view(std::string_view) { ++tokens; }
+  void json_number(double) { ++tokens; }
+  void json_boolean(bool) { ++tokens; }
+  void json_null() { ++tokens; }
+  void json_comma() { ++tokens; }
+  void json_colon() { ++tokens; }
+  void json_array_starts() { ++tokens; ++depth; }
+  void json_array_ends() { ++tokens; --depth; }
+  void json_object_starts() { ++tokens; ++depth; }
+  void json_object_ends() { ++tokens; --depth; }
+  void json_error(const std::string&) { failed = true; }
+  bool need_more_json() { return !failed && (tokens == 0 || depth > 0); }
+};
+
+BOOST_AUTO_TEST_CASE(ReadWithStaticCallback) {
+  counting_callback callback;
+
+  json::simple::run_tokenizer(std::string(R"%({"a": [1, true, null], "b": "c"})%"), callback);
+
+  BOOST_CHECK_EQUAL(15, callback.tokens);
+  BOOST_CHECK(!callback.failed);
+}
+
+BOOST_AUTO_TEST_CASE(ReadWithVirtualCallback) {
+  test_callback callback(stopper::array_end);
+  json::simple::token_callback& base = callback;
+
+  json::simple::run_tokenizer(std::string("[true]"), base);
+
+  BOOST_CHECK_EQUAL("[start][arr::start][boolean:true][arr::end][end]", callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadInChunks) {
+  const std::string source = R"%([null, "esc\"aped \ud83d\ude00", -12.5e1, true, {"key": false}])%";
+  test_callback expected(stopper::array_end);
+  run_tokenizer(source, expected);
+
+  // Every possible split into two chunks, and byte by byte feeding.
+  for (size_t split = 0; split <= source.size(); ++split) {
+    test_callback callback(stopper::array_end);
+    json::simple::push_tokenizer<test_callback> tokenizer(callback);
+
+    BOOST_CHECK_EQUAL(split < source.size(), tokenizer.feed(source.data(), split));
+    tokenizer.feed(source.data() + split, source.size() - split);
+    tokenizer.finish();
+
+    BOOST_CHECK_EQUAL(expected.buffer.str(), callback.buffer.str());
+  }
+
+  test_callback callback(stopper::array_end);
+  json::simple::push_tokenizer<test_callback> tokenizer(callback);
+  for (char c : source) {
+    tokenizer.feed(&c, 1);
+  }
+  BOOST_CHECK(tokenizer.done());
+  BOOST_CHECK_EQUAL(expected.buffer.str(), callback.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(ReadInChunksNumberAtEnd) {
+  test_callback callback(stopper::null);
+  json::simple::push_tokenizer<test_callback> tokenizer(callback);
+
+  tokenizer.feed("12", 2);
+  BOOST_CHECK_EQUAL("[start]", callback.buffer.str());
+  tokenizer.feed("34", 2);
+  tokenizer.finish();
+
+  BOOST_CHECK_EQUAL("[start][number:1234][error]", callback.buffer.str());
+}
+
+// Skips values of all object entries, document is expected to be a single object.
+struct skipping_callback : public test_callback {
+  bool after_colon = false;
+
+  skipping_callback() : test_callback(stopper::none) {}
+
+  void json_colon() override {
+    test_callback::json_colon();
+    after_colon = true;
+  }
+  bool skip_next_value() override {
+    return after_colon;
+  }
+  void json_value_skipped() override {
+    after_colon = false;
+    buffer << "[skipped]";
+  }
+  void json_object_ends() override {
+    test_callback::json_object_ends();
+    need_more = false;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(SkipValues) {
+  const std::string source = R"%({"a": {"x": [1, "]}"], "y": {}}, "b": -12.5, "c": "s\"}", "d": [[]], "e": null})%";
+  const std::string expected = "[start][object::start][string:a][colon][skipped][comma][string:b][colon][skipped][comma][string:c][colon][skipped]"
+                               "[comma][string:d][colon][skipped][comma][string:e][colon][skipped][object::end][end]";
+
+  skipping_callback callback;
+  run_tokenizer(source, callback);
+  BOOST_CHECK_EQUAL(expected, callback.buffer.str());
+
+  for (size_t split = 0; split <= source.size(); ++split) {
+    skipping_callback chunked;
+    json::simple::push_tokenizer<skipping_callback> tokenizer(chunked);
+    tokenizer.feed(source.data(), split);
+    tokenizer.feed(source.data() + split, source.size() - split);
+    tokenizer.finish();
+    BOOST_CHECK_EQUAL(expected, chunked.buffer.str());
+  }
+
+  skipping_callback unterminated;
+  run_tokenizer(std::string(R"%({"a": [1, {"b": 2})%"), unterminated);
+  BOOST_CHECK_EQUAL("[start][object::start][string:a][colon][error]", unterminated.buffer.str());
+}
+
+BOOST_AUTO_TEST_CASE(SkipValuesInSmallChunks) {
+  // Long key with escapes is read and long values are skipped while fed in small chunks. Each of them is scanned
+  // once rather than once per chunk, otherwise this takes minutes.
+  std::string key;
+  for (int i = 0; i < 100000; ++i) {
+    key += "abcdefgh\\\"";
+  }
+  key += "\\ud83d\\ude00";
+  std::string container = "[";
+  for (int i = 0; i < 100000; ++i) {
+    container += i == 0 ? R"%({"x": "]\"}"})%" : R"%(, {"x": "]\"}"})%";
+  }
+  container += "]";
+  const std::string source = "{\"" + key + "\": " + container + ", \"b\": \"" + key + "\"}";
+
+  std::string decoded;
+  for (int i = 0; i < 100000; ++i) {
+    decoded += "abcdefgh\"";
+  }
+  decoded += "\xF0\x9F\x98\x80";
+  const std::string expected = "[start][object::start][string:" + decoded + "][colon][skipped][comma][string:b][colon][skipped][object::end][end]";
+
+  skipping_callback whole;
+  run_tokenizer(source, whole);
+  BOOST_CHECK(expected == whole.buffer.str());
+
+  skipping_callback chunked;
+  json::simple::push_tokenizer<skipping_callback> tokenizer(chunked);
+  for (size_t offset = 0; offset < source.size(); offset += 61) {
+    tokenizer.feed(source.data() + offset, std::min<size_t>(61, source.size() - offset));
+  }
+  tokenizer.finish();
+  BOOST_CHECK(expected == chunked.buffer.str());
+}
+
+// Counts tokens of a long document, looking at the index as it goes.
+struct window_callback : public json::simple::token_callback {
+  const json::simple::tokenizer_buffers& buffers;
+  size_t numbers = 0;
+  size_t largest_index = 0;
+  bool failed = false;
+  size_t stop_after;
+
+  window_callback(const json::simple::tokenizer_buffers& _buffers, size_t _stop_after) : buffers(_buffers), stop_after(_stop_after) {}
+
+  void json_number(double) override {
+    ++numbers;
+    largest_index = std::max(largest_index, buffers.index.positions.capacity());
+  }
+  void json_array_ends() override { stop_after = numbers; }
+  void json_error(const std::string&) override { failed = true; }
+  bool need_more_json() override { return !failed && numbers < stop_after; }
+};
+
+BOOST_AUTO_TEST_CASE(IndexWindows) {
+  // Spaces between tokens make the tokenizer use the index. It's built a window at a time, so it never takes more
+  // than a window worth of positions, and an early stop doesn't index the rest of the document.
+  std::string source = "[";
+  for (int i = 0; i < 200000; ++i) {
+    source += i == 0 ? " 1" : " , 1";
+  }
+  source += std::string(3 * json::simple::detail::token_index::window_bytes, ' ') + " , \"tail\" ]";
+
+  json::simple::tokenizer_buffers buffers;
+  window_callback everything(buffers, SIZE_MAX);
+  json::simple::run_tokenizer(source.data(), source.size(), everything, buffers);
+  BOOST_CHECK(!everything.failed);
+  BOOST_CHECK_EQUAL(200000, everything.numbers);
+  BOOST_CHECK_LE(everything.largest_index, json::simple::detail::token_index::window_bytes);
+
+  window_callback early(buffers, 1);
+  json::simple::run_tokenizer(source.data(), source.size(), early, buffers);
+  BOOST_CHECK_EQUAL(1, early.numbers);
+  // The only window indexed starts at the space after '['.
+  BOOST_CHECK_EQUAL(source.data() + 1 + json::simple::detail::token_index::window_bytes, buffers.index.indexed);
+}
+
 BOOST_AUTO_TEST_SUITE_END() 
@@ -0,0 +1,134 @@
+#include <boost/test/unit_test.hpp>
+
+#include "json_simd.h"
+#include <string>
+#include <vector>
+#include <random>
+
+BOOST_AUTO_TEST_SUITE(JSONStructuralIndex)
+
+// Index rendered as characters found at indexed positions, easier to read in failures.
+std::string indexed_chars(const std::string& source, json::simd::kernel k) {
+  std::vector<uint32_t> positions;
+  json::simd::build_structural_index(source.data(), source.size(), positions, k);
+  std::string result;
+  for (auto p : positions) {
+    result.push_back(source[p]);
+  }
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(IndexSimpleDocument) {
+  for (auto k : json::simd::available_kernels()) {
+    BOOST_TEST_CONTEXT("kernel " << json::simd::kernel_name(k)) {
+      BOOST_CHECK_EQUAL("{\":[1,t,n,-]}", indexed_chars(R"%({ "key" : [ 12, true,null, -1.5e3 ] })%", k));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(IndexSkipsStringContents) {
+  for (auto k : json::simd::available_kernels()) {
+    BOOST_TEST_CONTEXT("kernel " << json::simd::kernel_name(k)) {
+      BOOST_CHECK_EQUAL("[\",\",\"]", indexed_chars(R"%(["a,b]{}", "esc\"aped:\\", "\\\\"])%", k));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(IndexAcrossBlockBoundaries) {
+  // String and backslash runs straddling 64 byte block boundaries.
+  for (size_t shift = 0; shift < 70; ++shift) {
+    std::string source = "[" + std::string(shift, ' ') + "\"" + std::string(61, 'x') + "\\\\\\\"{\", 1]";
+    for (auto k : json::simd::available_kernels()) {
+      BOOST_TEST_CONTEXT("kernel " << json::simd::kernel_name(k) << " shift " << shift) {
+        BOOST_CHECK_EQUAL("[\",1]", indexed_chars(source, k));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(KernelsAgree) {
+  const std::string alphabet = "{}[]:,\"\\ \n\tab1";
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+
+  for (int round = 0; round < 200; ++round) {
+    std::string source;
+    for (int i = 0; i < 300; ++i) {
+      source.push_back(alphabet[pick(generator)]);
+    }
+
+    std::vector<uint32_t> expected;
+    json::simd::build_structural_index(source.data(), source.size(), expected, json::simd::kernel::scalar);
+    for (auto k : json::simd::available_kernels()) {
+      std::vector<uint32_t> actual;
+      json::simd::build_structural_index(source.data(), source.size(), actual, k);
+      BOOST_CHECK(expected == actual);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FindQuoteOrBackslash) {
+  for (size_t length = 0; length < 150; ++length) {
+    std::string source(length, 'a');
+    for (auto k : json::simd::available_kernels()) {
+      BOOST_TEST_CONTEXT("kernel " << json::simd::kernel_name(k) << " length " << length) {
+        const char* end = source.data() + source.size();
+        BOOST_CHECK(end == json::simd::find_quote_or_backslash(source.data(), end, k));
+        for (size_t at = 0; at < length; at += 7) {
+          std::string probe = source;
+          probe[at] = (at % 2) ? '"' : '\\';
+          if (at + 3 < length) {
+            probe[at + 3] = '"';
+          }
+          BOOST_CHECK_EQUAL(at, json::simd::find_quote_or_backslash(probe.data(), probe.data() + length, k) - probe.data());
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FindQuoteOrBracket) {
+  const std::string specials = "\"[]{}";
+  for (size_t length = 0; length < 150; ++length) {
+    std::string source(length, ';');
+    for (size_t at = 0; at < length; at += 5) {
+      source[at] = "a:,\\z"[at % 5]; // Similar characters that must not match.
+    }
+    for (auto k : json::simd::available_kernels()) {
+      BOOST_TEST_CONTEXT("kernel " << json::simd::kernel_name(k) << " length " << length) {
+        const char* end = source.data() + source.size();
+        BOOST_CHECK(end == json::simd::find_quote_or_bracket(source.data(), end, k));
+        for (size_t at = 0; at < length; at += 7) {
+          std::string probe = source;
+          probe[at] = specials[at % specials.size()];
+          if (at + 3 < length) {
+            probe[at + 3] = '"';
+          }
+          BOOST_CHECK_EQUAL(at, json::simd::find_quote_or_bracket(probe.data(), probe.data() + length, k) - probe.data());
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FindUint32) {
+  for (size_t length = 0; length < 40; ++length) {
+    std::vector<uint32_t> words(length);
+    for (size_t i = 0; i < length; ++i) {
+      words[i] = uint32_t(i) * 0x01010101u; // Bytes of other words may match the needle's ones.
+    }
+    for (auto k : json::simd::available_kernels()) {
+      BOOST_TEST_CONTEXT("kernel " << json::simd::kernel_name(k) << " length " << length) {
+        const uint32_t* begin = words.data();
+        const uint32_t* end = begin + length;
+        BOOST_CHECK(end == json::simd::find_uint32(begin, end, 0xFFu, k));
+        for (size_t at = 0; at < length; ++at) {
+          BOOST_CHECK_EQUAL(at, json::simd::find_uint32(begin, end, words[at], k) - begin);
+          BOOST_CHECK_EQUAL(length, json::simd::find_uint32(begin + at + 1, end, words[at], k) - begin);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
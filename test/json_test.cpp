@@ -1,11 +1,16 @@
 #include <boost/test/unit_test.hpp>
 
 #include "json.h"
+#include "test_resources.h"
+#include <algorithm>
+#include <numeric>
 #include <string>
 #include <ostream>
 #include <sstream>
 #include <iostream>
+#include <memory_resource>
 #include <unordered_set>
+#include <utility>
 
 // Following is thanks to this explanation: http://stackoverflow.com/a/18817428
 struct boost_compatible_unordered_set : public std::unordered_set<std::string> {
@@ -135,6 +140,26 @@ BOOST_AUTO_TEST_CASE(ObjectStuff) {
   BOOST_CHECK_EQUAL(1, object_proxy.size());
 }
 
+BOOST_AUTO_TEST_CASE(InsertAndReserve) {
+  json::value object(json::value_type::object);
+  object.reserve(2);
+
+  std::string key = "key";
+  object.insert_or_assign(std::move(key), "value");
+  object.insert_or_assign("key", 2.0);
+  BOOST_CHECK_EQUAL(1, object.size());
+  BOOST_CHECK_EQUAL(2.0, object["key"].as_number());
+
+  json::value array(json::value_type::array);
+  array.reserve(3);
+  array.push(1.0);
+  BOOST_CHECK_EQUAL(1, array.size());
+
+  json::value number(1.0);
+  BOOST_CHECK_THROW(number.reserve(1), json::json_error);
+  BOOST_CHECK_THROW(array.insert_or_assign("key", 1.0), json::json_error);
+}
+
 
 BOOST_AUTO_TEST_CASE(ObjectIteration) {
   json::value object(json::value_type::object);
@@ -246,6 +271,440 @@ BOOST_AUTO_TEST_CASE(ArrayIteration) {
   BOOST_CHECK_EQUAL("[valueA][valueB][valueC]", ss.str());
 }
 
+BOOST_AUTO_TEST_CASE(IteratorFamily) {
+  json::value object{{"b", 2.0}, {"a", 1.0}, {"c", 3.0}};
+  std::string keys;
+  for (auto& [key, val] : object.as_object()) {
+    keys += key;
+    val = val.as_number() * 10;
+  }
+  BOOST_CHECK_EQUAL("bac", keys);
+  auto entries = object.as_object();
+  BOOST_CHECK_EQUAL(3, std::distance(entries.begin(), entries.end()));
+  BOOST_CHECK_EQUAL("c", entries.begin()[2].first);
+  BOOST_CHECK_EQUAL(20, entries.begin()->second.as_number());
+  // Entries are the stored ones, so references don't change as the iterator moves.
+  auto it = entries.begin();
+  auto& first = *it;
+  ++it;
+  BOOST_CHECK_EQUAL("b", first.first);
+  BOOST_CHECK_EQUAL("a", it->first);
+  BOOST_CHECK_EQUAL("b", std::prev(it)->first);
+  BOOST_CHECK(&first.second == &object["b"]);
+  json::object_value::const_iterator converted = entries.begin();
+  BOOST_CHECK(converted == entries.cbegin());
+  BOOST_CHECK(++converted != entries.cend());
+
+  json::value array(json::value_type::array);
+  for (double number : {3.0, 1.0, 2.0}) {
+    array.push(number);
+  }
+  auto elements = array.as_array();
+  std::sort(elements.begin(), elements.end(), [](const json::value& l, const json::value& r) { return l.as_number() < r.as_number(); });
+  BOOST_CHECK_EQUAL("[1,2,3]", array.serialize());
+  BOOST_CHECK_EQUAL(3, elements.end() - elements.begin());
+  BOOST_CHECK_EQUAL(2, (elements.begin() + 1)->as_number());
+  BOOST_CHECK_EQUAL(3, elements.cend()[-1].as_number());
+  BOOST_CHECK(std::is_sorted(elements.cbegin(), elements.cend(), [](const json::value& l, const json::value& r) { return l.as_number() < r.as_number(); }));
+
+  // Const values get read-only views.
+  const json::value& const_object = object;
+  double sum = 0;
+  for (const auto& [key, val] : const_object.as_object()) {
+    sum += val.as_number();
+  }
+  BOOST_CHECK_EQUAL(60, sum);
+  BOOST_CHECK_EQUAL(10, const_object.as_object()["a"].as_number());
+  BOOST_CHECK(const_object.as_object().has(json::key("c")));
+  BOOST_CHECK_THROW(const_object.as_object()["missing"], json::json_error);
+  const json::value& const_array = array;
+  BOOST_CHECK_EQUAL(6, std::accumulate(const_array.as_array().begin(), const_array.as_array().end(), 0.0, [](double total, const json::value& el) { return total + el.as_number(); }));
+  BOOST_CHECK_THROW(const_array.as_array()[3], std::out_of_range);
+  BOOST_CHECK_THROW(const_array.as_object(), json::json_error);
+}
+
+BOOST_AUTO_TEST_CASE(ObjectOrderAndIndex) {
+  json::value object(json::value_type::object);
+  object["b"] = 1.0;
+  object["a"] = 2.0;
+  object["c"] = 3.0;
+  object["a"] = 4.0;
+  BOOST_CHECK_EQUAL(R"%({"b":1,"a":4,"c":3})%", object.serialize());
+  object.remove("b");
+  BOOST_CHECK_EQUAL(R"%({"a":4,"c":3})%", object.serialize());
+
+  // Objects above the threshold are indexed, entries keep their order nonetheless.
+  json::value large(json::value_type::object);
+  std::string expected = "{";
+  for (int i = 0; i < 300; ++i) {
+    large.insert_or_assign("key" + std::to_string(i), double(i));
+    expected += (i ? ",\"key" : "\"key") + std::to_string(i) + "\":" + std::to_string(i);
+  }
+  BOOST_CHECK_EQUAL(expected + "}", large.serialize());
+  for (int i = 0; i < 300; ++i) {
+    BOOST_CHECK_EQUAL(i, large["key" + std::to_string(i)].as_number());
+  }
+  BOOST_CHECK(!large.has("key300"));
+
+  // Removing entries shrinks it back below the threshold.
+  for (int i = 0; i < 300; i += 2) {
+    large.remove("key" + std::to_string(i));
+  }
+  BOOST_CHECK_EQUAL(150, large.size());
+  for (int i = 0; i < 300; ++i) {
+    BOOST_CHECK_EQUAL(i % 2 == 1, large.has("key" + std::to_string(i)));
+  }
+  for (int i = 1; i < 280; i += 2) {
+    large.remove("key" + std::to_string(i));
+  }
+  BOOST_CHECK_EQUAL(R"%({"key281":281,"key283":283,"key285":285,"key287":287,"key289":289,"key291":291,"key293":293,"key295":295,"key297":297,"key299":299})%", large.serialize());
+  BOOST_CHECK_EQUAL(299, large["key299"].as_number());
+
+  // Equality doesn't depend on order.
+  json::value reordered{{"c", 3.0}, {"a", 4.0}};
+  BOOST_CHECK(object == reordered);
+  reordered["a"] = 5.0;
+  BOOST_CHECK(object != reordered);
+}
+
+BOOST_AUTO_TEST_CASE(CompactLayout) {
+  BOOST_CHECK_EQUAL(16, sizeof(json::value)); // Resource (with the type in its low bits or in a byte after it) and the payload.
+
+  // Moving takes the payload, the source is left null.
+  json::value text("a string long enough to be allocated");
+  json::value moved(std::move(text));
+  BOOST_CHECK(text.is_null());
+  BOOST_CHECK_EQUAL("a string long enough to be allocated", moved.as_string());
+  json::value object{{"a", 1.0}};
+  json::value target(json::value_type::array);
+  target = std::move(object);
+  BOOST_CHECK(object.is_null());
+  BOOST_CHECK_EQUAL(R"%({"a":1})%", target.serialize());
+
+  // Strings are reused in place while they fit, empty ones take no storage.
+  json::value str("");
+  BOOST_CHECK_EQUAL("", str.as_string());
+  str = "abcdef";
+  str = std::string_view("abc");
+  BOOST_CHECK_EQUAL("abc", str.as_string());
+  str = "";
+  BOOST_CHECK_EQUAL("", str.as_string());
+  BOOST_CHECK(str == json::value(""));
+
+  json::value number(1.0);
+  swap(moved, number);
+  BOOST_CHECK_EQUAL(1, moved.as_number());
+  BOOST_CHECK_EQUAL("a string long enough to be allocated", number.as_string());
+}
+
+BOOST_AUTO_TEST_CASE(Document) {
+  counting_resource upstream;
+  const std::string long_string(100, 'x');
+  {
+    json::document doc(&upstream);
+    BOOST_CHECK(doc.root().is_null());
+
+    json::value heap{{"key", long_string}, {"list", json::value(json::value_type::array)}};
+    doc.root() = heap;
+    doc.root()["list"].push(long_string);
+    doc.root()["list"].push(std::move(heap));
+    doc.root()["other"] = long_string.c_str();
+    BOOST_CHECK(upstream.allocations > 0);
+
+    BOOST_CHECK(doc.root().get_resource() == doc.resource());
+    BOOST_CHECK(doc.root()["key"].get_resource() == doc.resource());
+    BOOST_CHECK(doc.root()["list"][1]["key"].get_resource() == doc.resource());
+    BOOST_CHECK(doc.root()["other"].get_resource() == doc.resource());
+    BOOST_CHECK_EQUAL(long_string, doc.root()["list"][1]["key"].as_string());
+
+    // Copies leave the arena.
+    json::value copy = doc.root()["list"];
+    BOOST_CHECK(copy.get_resource() == std::pmr::get_default_resource());
+    BOOST_CHECK(copy[0].get_resource() == std::pmr::get_default_resource());
+
+    auto moved = std::move(doc);
+    BOOST_CHECK_EQUAL(long_string, moved.root()["other"].as_string());
+    moved.clear();
+    BOOST_CHECK(moved.root().is_null());
+    moved.root() = copy;
+    BOOST_CHECK_EQUAL(2, moved.root().size());
+
+    // Self-move keeps the tree, moved-from document is reused after clear().
+    auto& same = moved;
+    moved = std::move(same);
+    BOOST_CHECK_EQUAL(long_string, moved.root()[0].as_string());
+    doc.clear();
+    BOOST_CHECK(doc.root().is_null());
+    BOOST_CHECK(doc.resource() != moved.resource());
+    doc.root() = json::value{{"key", long_string}};
+    doc.intern("key");
+    BOOST_CHECK_EQUAL(long_string, doc.root()["key"].as_string());
+    moved = std::move(doc);
+    BOOST_CHECK_EQUAL(long_string, moved.root()["key"].as_string());
+    doc.clear();
+    BOOST_CHECK(doc.root().is_null());
+  }
+  BOOST_CHECK_EQUAL(0, upstream.outstanding);
+
+  // Nothing goes upstream while the buffer suffices.
+  char buffer[4096];
+  json::document doc(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+  doc.root() = json::value{{"key", long_string}};
+  doc.root()["key"] = 1.0;
+  BOOST_CHECK_EQUAL(1, doc.root()["key"].as_number());
+  BOOST_CHECK_THROW(doc.root()["key"] = std::string(8192, 'x').c_str(), std::bad_alloc);
+}
+
+BOOST_AUTO_TEST_CASE(KeyLookup) {
+  counting_resource resource;
+  json::value object(json::value_type::object, &resource);
+  object["a key long enough to be allocated"] = 1.0;
+  object[std::string_view("b")] = 2.0;
+
+  // Lookups of keys that are there, by view or by key, allocate nothing.
+  const json::key a("a key long enough to be allocated");
+  const size_t allocations = resource.allocations;
+  BOOST_CHECK_EQUAL(1, object["a key long enough to be allocated"].as_number());
+  BOOST_CHECK_EQUAL(1, object[a].as_number());
+  BOOST_CHECK(object.has(a));
+  BOOST_CHECK(object.as_object().has(a));
+  BOOST_CHECK_EQUAL(2, object.as_object()[std::string_view("b")].as_number());
+  BOOST_CHECK_EQUAL(allocations, resource.allocations);
+
+  json::key c("c");
+  BOOST_CHECK(!object.has(c));
+  object[c] = 3.0;
+  json::key copy = c;
+  BOOST_CHECK_EQUAL(3, object[copy].as_number());
+  BOOST_CHECK_EQUAL(c.hash(), copy.hash());
+  object.remove(copy);
+  object.as_object().remove(a);
+  BOOST_CHECK_EQUAL(R"%({"b":2})%", object.serialize());
+
+  // Moved-from key is the empty one and stays usable.
+  json::key moved("abc");
+  json::key target(std::move(moved));
+  json::key moved_copy(moved);
+  BOOST_CHECK_EQUAL("abc", target.text());
+  BOOST_CHECK_EQUAL("", moved.text());
+  BOOST_CHECK_EQUAL(json::key("").hash(), moved_copy.hash());
+  BOOST_CHECK(!object.has(moved));
+  object[moved] = 5.0;
+  BOOST_CHECK_EQUAL(5, object[""].as_number());
+  object.remove(moved_copy);
+  moved = target;
+  BOOST_CHECK_EQUAL("abc", moved.text());
+
+  // Keys of a document are shared by its objects.
+  json::document doc;
+  const json::key id = doc.intern("_id");
+  doc.root() = json::value(json::value_type::object);
+  doc.root()[id] = 1.0;
+  BOOST_CHECK((*doc.root().as_object().begin()).first.data() == id.text().data());
+  BOOST_CHECK_EQUAL(1, doc.root()[json::key("_id")].as_number());
+  object[id] = 4.0;
+  BOOST_CHECK_EQUAL(4, object["_id"].as_number());
+}
+
+BOOST_AUTO_TEST_CASE(CopyOnWrite) {
+  counting_resource resource;
+  const std::string long_string(100, 'x');
+  json::value original(json::value_type::object, &resource);
+  original["a key long enough to be allocated"] = long_string;
+  original["list"] = json::value(json::value_type::array, &resource);
+  original["list"].push(json::value(json::value_type::object, &resource));
+  original["list"][0]["name"] = "first";
+  original["list"].push(long_string);
+  original["other"] = json::value(json::value_type::array, &resource);
+  original["other"].push(1.0);
+
+  // References to children of the original were handed out while it was built, so its copy copies containers on their
+  // way (the root with its long key, the list with its elements and the object in it). Copies of the copy with the
+  // same resource share everything.
+  json::value copy(original, &resource);
+  const size_t allocations = resource.allocations;
+  json::value another(json::value_type::null, &resource);
+  another = copy;
+  BOOST_CHECK_EQUAL(allocations, resource.allocations);
+  BOOST_CHECK(original == copy);
+  // Reading through const access doesn't copy anything, non-const access copies containers on the way.
+  BOOST_CHECK_EQUAL(long_string, std::as_const(copy).as_object()["list"].as_array()[1].as_string());
+  BOOST_CHECK_EQUAL(allocations, resource.allocations);
+
+  // Writing copies only the containers on the way (the root with its long key, the list with its elements and the
+  // object in it) and the new string, siblings stay shared.
+  copy["list"][0]["name"] = "second";
+  BOOST_CHECK_EQUAL(allocations + 6, resource.allocations);
+  BOOST_CHECK_EQUAL("first", original["list"][0]["name"].as_string());
+  BOOST_CHECK_EQUAL("first", another["list"][0]["name"].as_string());
+  BOOST_CHECK_EQUAL("second", copy["list"][0]["name"].as_string());
+  BOOST_CHECK(&std::as_const(copy).as_object()["other"].as_array()[0] == &std::as_const(original).as_object()["other"].as_array()[0]);
+
+  // Shared string is replaced rather than written over.
+  another["a key long enough to be allocated"] = "short";
+  BOOST_CHECK_EQUAL(long_string, original["a key long enough to be allocated"].as_string());
+  BOOST_CHECK_EQUAL("short", another["a key long enough to be allocated"].as_string());
+
+  for (auto& element : another["other"].as_array()) {
+    element = 2.0;
+  }
+  another.remove("list");
+  BOOST_CHECK_EQUAL(R"%({"a key long enough to be allocated":"short","other":[2]})%", another.serialize());
+  BOOST_CHECK_EQUAL(1, original["other"][0].as_number());
+  BOOST_CHECK_EQUAL(2, original["list"].size());
+
+  // Copy with another resource is deep.
+  json::value heap(original);
+  BOOST_CHECK(heap == original);
+  heap["list"][0]["name"] = "third";
+  BOOST_CHECK_EQUAL("first", original["list"][0]["name"].as_string());
+
+  original = nullptr;
+  copy = nullptr;
+  another = nullptr;
+  BOOST_CHECK_EQUAL(0, resource.outstanding);
+}
+
+BOOST_AUTO_TEST_CASE(CopyAfterHandingOutReferences) {
+  // Writes through references and iterators taken before a copy don't reach the copy.
+  json::value object{{"x", 1.0}, {"y", 2.0}};
+  json::value& x = object["x"];
+  json::value object_copy = object;
+  x = 5.0;
+  BOOST_CHECK_EQUAL(R"%({"x":5,"y":2})%", object.serialize());
+  BOOST_CHECK_EQUAL(R"%({"x":1,"y":2})%", object_copy.serialize());
+
+  json::value list(json::value_type::array);
+  list.push(1.0);
+  list.push(2.0);
+  auto element = list.as_array().begin();
+  json::value list_copy = list;
+  *element = 3.0;
+  BOOST_CHECK_EQUAL("[3,2]", list.serialize());
+  BOOST_CHECK_EQUAL("[1,2]", list_copy.serialize());
+
+  auto entry = object.as_object().begin();
+  object_copy = object;
+  entry->second = 6.0;
+  BOOST_CHECK_EQUAL(5, object_copy["x"].as_number());
+
+  // Every container on the way to a reference is copied.
+  json::value outer(json::value_type::object);
+  json::value& inner = outer["inner"] = json::value(json::value_type::object);
+  json::value& z = inner["z"] = 1.0;
+  json::value outer_copy = outer;
+  z = 2.0;
+  BOOST_CHECK_EQUAL(R"%({"inner":{"z":2}})%", outer.serialize());
+  BOOST_CHECK_EQUAL(R"%({"inner":{"z":1}})%", outer_copy.serialize());
+
+  // So is every container that adopts one with a reference handed out earlier.
+  json::value child{{"k", 1.0}};
+  json::value& k = child["k"];
+  json::value parent(json::value_type::array);
+  parent.push(std::move(child));
+  json::value parent_copy = parent;
+  k = 5.0;
+  BOOST_CHECK_EQUAL(R"%([{"k":5}])%", parent.serialize());
+  BOOST_CHECK_EQUAL(R"%([{"k":1}])%", parent_copy.serialize());
+
+  json::value grandchild{{"k", 1.0}};
+  json::value& l = grandchild["k"];
+  json::value wrapper(json::value_type::array);
+  wrapper.as_array().push(std::move(grandchild));
+  json::value holder(json::value_type::object);
+  holder.insert_or_assign("wrapper", std::move(wrapper));
+  json::value holder_copy = holder;
+  l = 5.0;
+  BOOST_CHECK_EQUAL(R"%({"wrapper":[{"k":5}]})%", holder.serialize());
+  BOOST_CHECK_EQUAL(R"%({"wrapper":[{"k":1}]})%", holder_copy.serialize());
+}
+
+BOOST_AUTO_TEST_CASE(HashAndEquality) {
+  json::value object{{"a", 1.0}, {"b", "string"}, {"c", json::value(json::value_type::array)}};
+  object["c"].push(0.0);
+  object["c"].push(json::value(json::value_type::object));
+  json::value reordered{{"c", json::value(json::value_type::array)}, {"b", "string"}, {"a", 1.0}};
+  reordered["c"].push(-0.0);
+  reordered["c"].push(json::value(json::value_type::object));
+  BOOST_CHECK(object == reordered);
+  BOOST_CHECK_EQUAL(json::hash(object), json::hash(reordered));
+
+  json::value swapped_elements = object;
+  std::swap(swapped_elements["c"][0], swapped_elements["c"][1]);
+  BOOST_CHECK(object != swapped_elements);
+  BOOST_CHECK_NE(json::hash(object), json::hash(swapped_elements));
+  BOOST_CHECK_NE(json::hash(json::value("1")), json::hash(json::value(1.0)));
+  BOOST_CHECK_NE(json::hash(json::value(json::value_type::array)), json::hash(json::value(json::value_type::object)));
+
+  // Hash cached while the object is shared goes away once it is modified.
+  json::value copy = object;
+  const size_t original = json::hash(object);
+  BOOST_CHECK_EQUAL(original, json::hash(copy));
+  copy = nullptr;
+  object["a"] = 2.0;
+  BOOST_CHECK_NE(original, json::hash(object));
+  BOOST_CHECK(object != reordered);
+  object["a"] = 1.0;
+  BOOST_CHECK_EQUAL(original, json::hash(object));
+  BOOST_CHECK(object == reordered);
+
+  // Same for an array and for modifications of shared copies.
+  json::value list = object["c"];
+  const size_t list_hash = json::hash(list);
+  BOOST_CHECK_EQUAL(list_hash, json::hash(object["c"]));
+  list.push(true);
+  BOOST_CHECK_NE(list_hash, json::hash(list));
+  BOOST_CHECK(list != object["c"]);
+  list.remove(2);
+  BOOST_CHECK(list == object["c"]);
+
+  std::unordered_set<json::value> unique{object, reordered, swapped_elements, copy, json::value()};
+  BOOST_CHECK_EQUAL(3, unique.size());
+
+  // Writes through a reference or iterator held across a copy are seen by hash and equality.
+  json::value held{{"x", 1.0}, {"y", 2.0}};
+  json::value& x = held["x"];
+  json::value held_copy = held;
+  const size_t held_hash = json::hash(held);
+  BOOST_CHECK_EQUAL(held_hash, json::hash(held_copy));
+  x = 5.0;
+  const json::value fresh{{"x", 5.0}, {"y", 2.0}};
+  BOOST_CHECK(held == fresh);
+  BOOST_CHECK_EQUAL(json::hash(fresh), json::hash(held));
+  BOOST_CHECK(held != held_copy);
+  BOOST_CHECK_EQUAL(held_hash, json::hash(held_copy));
+
+  json::value numbers(json::value_type::array);
+  numbers.push(1.0);
+  numbers.push(2.0);
+  auto number = numbers.as_array().begin();
+  json::value numbers_copy = numbers;
+  const size_t numbers_hash = json::hash(numbers);
+  *number = 3.0;
+  json::value fresh_numbers(json::value_type::array);
+  fresh_numbers.push(3.0);
+  fresh_numbers.push(2.0);
+  BOOST_CHECK(numbers == fresh_numbers);
+  BOOST_CHECK_EQUAL(json::hash(fresh_numbers), json::hash(numbers));
+  BOOST_CHECK_EQUAL(numbers_hash, json::hash(numbers_copy));
+
+  // And through a reference taken before the value was moved into its parent.
+  json::value pushed{{"k", 1.0}};
+  json::value& k = pushed["k"];
+  json::value parent(json::value_type::array);
+  parent.push(std::move(pushed));
+  json::value parent_copy = parent;
+  const size_t parent_hash = json::hash(parent);
+  BOOST_CHECK_EQUAL(parent_hash, json::hash(parent_copy));
+  k = 5.0;
+  json::value fresh_parent(json::value_type::array);
+  fresh_parent.push(json::value{{"k", 5.0}});
+  BOOST_CHECK(parent == fresh_parent);
+  BOOST_CHECK_EQUAL(json::hash(fresh_parent), json::hash(parent));
+  BOOST_CHECK(parent != parent_copy);
+  BOOST_CHECK_EQUAL(parent_hash, json::hash(parent_copy));
+}
+
 // BOOST_AUTO_TEST_CASE(ArrayLiteral) {
 //   json::value object{"valueA", 1.0, false};
 
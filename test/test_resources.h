@@ -0,0 +1,29 @@
+#ifndef _TEST_RESOURCES_H_
+#define _TEST_RESOURCES_H_
+
+// Memory resources shared by tests.
+
+#include <cstddef>
+#include <memory_resource>
+
+// Upstream resource that counts allocations and keeps track of memory it hands out, so that tests can pin
+// the number of allocations and check that everything is given back.
+struct counting_resource : std::pmr::memory_resource {
+  size_t allocations = 0;
+  size_t outstanding = 0;
+
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    outstanding += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+#endif // _TEST_RESOURCES_H_